@@ -1,8 +1,8 @@
 /* 
  * File: BigInt.h
  *
- * Brief: Big Integer utility for arbitrary precision arithmetic. Currently
- *        BigInt only supports strings in hexadecimal format
+ * Brief: Big Integer utility for arbitrary precision arithmetic. Strings are
+ *        read and written in bases 2 to 36, hexadecimal by default
  *
  * Author: Alexander DuPre
  *
@@ -13,30 +13,73 @@
 
 #define BIGINT_VERSION "v0.1"
 
+// The base of str_BigInt, str_base_BigInt and to_string take any base
 #define BIGINT_RADIX 16
 
+#include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 
 #if defined( BIGINT__8bit )
     typedef uint8_t bucket_t;
     typedef int8_t  sbucket_t;
     #define BUCKET_WIDTH 8
     #define BUCKET_MAX_SIZE UINT8_MAX
+    #define KARATSUBA_THRESHOLD 24
+    #define KARATSUBA_SQR_THRESHOLD 48
+    #define TOOM3_THRESHOLD 96
+    #define NTT_THRESHOLD 128
+    #define NEWTON_DIV_THRESHOLD 384
+    #define RADIX_DC_THRESHOLD 16
+    #define PARALLEL_THRESHOLD 4096
 #elif defined( BIGINT__x64 )
     typedef uint64_t bucket_t;
     typedef int64_t  sbucket_t;
     #define BUCKET_WIDTH 64
     #define BUCKET_MAX_SIZE UINT64_MAX
+    #define KARATSUBA_THRESHOLD 32
+    #define KARATSUBA_SQR_THRESHOLD 96
+    #define TOOM3_THRESHOLD 128
+    #define NTT_THRESHOLD 12288
+    #define NEWTON_DIV_THRESHOLD 512
+    #define RADIX_DC_THRESHOLD 64
+    #define PARALLEL_THRESHOLD 512
 #else // BIGINT__x86
     typedef uint32_t bucket_t;
     typedef int32_t  sbucket_t;
     #define BUCKET_WIDTH 32
     #define BUCKET_MAX_SIZE UINT32_MAX
+    #define KARATSUBA_THRESHOLD 32
+    #define KARATSUBA_SQR_THRESHOLD 96
+    #define TOOM3_THRESHOLD 128
+    #define NTT_THRESHOLD 2048
+    #define NEWTON_DIV_THRESHOLD 512
+    #define RADIX_DC_THRESHOLD 64
+    #define PARALLEL_THRESHOLD 1024
 #endif // BIGINT__SIZE
 
 /*
  * bucket_t is an unsigned integral type that represents portions of the BigInt
  *
+ * KARATSUBA_THRESHOLD, TOOM3_THRESHOLD and NTT_THRESHOLD are the bucket counts
+ * of the shorter operand at which multiplication switches from schoolbook to
+ * Karatsuba, from Karatsuba to Toom-Cook 3 and from Toom-Cook 3 to the number
+ * theoretic transform. KARATSUBA_SQR_THRESHOLD is the schoolbook to Karatsuba
+ * cutover for squaring, which has a cheaper schoolbook loop
+ *
+ * NEWTON_DIV_THRESHOLD is the bucket count of the quotient at which division
+ * switches from schoolbook long division to multiplying by a Newton-Raphson
+ * reciprocal of the divisor, provided the divisor is at least half as long
+ *
+ * RADIX_DC_THRESHOLD is the bucket count at which converting a string in a base
+ * that isn't a power of two switches from multiplying in one bucket of digits
+ * at a time to recursively combining halves
+ *
+ * PARALLEL_THRESHOLD is the bucket count of the sub products of Karatsuba and
+ * Toom-Cook 3 at which they are computed in parallel when BigInt_set_threads
+ * has started worker threads. The products of the mont functions and powmod
+ * always run on the calling thread
+ *
  * sbucket_t is the signed integral of bucket_t and is meant for the user to quickly
  * assign values to the BigInt when the values are less than BUCKET_MAX_SIZE
  * sbucket_t is also used for comparison of the BigInt with fixed precision integers
@@ -49,7 +92,7 @@
 typedef struct BigInt BigInt;
 
 // Returns BigInt with N buckets allocated, all with a value of 0
-BigInt* reserve_BigInt(bucket_t buckets);
+BigInt* reserve_BigInt(size_t buckets);
 
 // Returns allocated empty BigInt, if malloc fails returns NULL
 BigInt* empty_BigInt();
@@ -57,29 +100,319 @@ BigInt* empty_BigInt();
 // Returns allocated BigInt with stored value, if malloc fails returns NULL
 BigInt* val_BigInt(bucket_t num);
 
-// Returns BigInt with value represented by num. Returns empty_BigInt() if num
-// cannot be converted
+// Returns BigInt with value represented by num in base BIGINT_RADIX. Returns
+// empty_BigInt() if num cannot be converted
 BigInt* str_BigInt(const char* num);
 
+// Returns BigInt with value represented by num in base 2 to 36, digits past 9
+// are the letters a to z in either case. A base 16 string may have the 0x 
+// prefix. Returns empty_BigInt() if base is invalid or num cannot be converted
+BigInt* str_base_BigInt(const char* num, int base);
+
+// Byte orders of import_bytes and export_bytes, native is the host's order
+#define BIGINT_LITTLE_ENDIAN -1
+#define BIGINT_NATIVE_ENDIAN 0
+#define BIGINT_BIG_ENDIAN 1
+
+// Returns a non negative BigInt from the len byte magnitude in bytes. Returns
+// NULL if bytes is NULL and len isn't 0, or malloc fails
+BigInt* import_bytes(const uint8_t* bytes, size_t len, int endian);
+
+// Returns a BigInt that uses the caller's array of nbuckets buckets, least
+// significant first, without copying it. Operations that work in place write
+// to the array, an operation that has to resize the BigInt moves it into its
+// own copy. free_BigInt leaves the array alone. The used length is counted 
+// here, so the caller mustn't change the array while the view is alive. 
+// Returns NULL if buckets is NULL, nbuckets is 0 or malloc fails
+BigInt* view_BigInt(bucket_t* buckets, size_t nbuckets);
+
 // Resets all buckets to 0, returns num
 BigInt* clear_BigInt(BigInt* num);
 
+// Makes room for capacity buckets so in place operations up to that size 
+// don't reallocate, a view or mapping that has to grow is moved into its own
+// copy. Never shrinks. Returns num, or NULL if num is NULL or malloc fails
+BigInt* reserve_capacity(BigInt* num, size_t capacity);
+
+// Releases the buckets above the value of num, a view or mapping with spare 
+// buckets is moved into its own copy. Returns num, or NULL if num is NULL or 
+// memory can't be allocated
+BigInt* shrink_to_fit(BigInt* num);
+
 // Creates a new big int with the sum of b1 + b2
 BigInt* add(BigInt* b1, BigInt* b2);
 
-// Adds src into destination, growing dest if necessary
+// Adds src into destination, growing dest if necessary. Returns NULL if dest
+// can't grow
 BigInt* add_into(BigInt* src, BigInt* dest);
 
 // Creates a new big int with the sum b1 - b2
 BigInt* subtract(BigInt* b1, BigInt* b2);
 
-// Subtracts src from dest, growing dest if necessary
+// Subtracts src from dest, growing dest if necessary. Returns NULL if dest 
+// can't grow
 BigInt* subtract_from(BigInt* src, BigInt* dest);
 
+// Creates a new big int with the product b1 * b2
+BigInt* multiply(BigInt* b1, BigInt* b2);
+
+// Multiplies dest by src, growing dest if necessary
+BigInt* multiply_into(BigInt* src, BigInt* dest);
+
+// Creates a new big int with the square of num. Squaring only computes half
+// of the cross products and is cheaper than multiply(num, num)
+BigInt* square(BigInt* num);
+
+// Squares num in place, growing num if necessary
+BigInt* square_into(BigInt* num);
+
+// Creates a new big int with base^e. The result is sized from the bit length
+// of base and allocated once, a power of two base is shifted instead. Returns
+// NULL if base is NULL or the result would not be addressable
+BigInt* pow_BigInt(BigInt* base, uint64_t e);
+
+// Computes the quotient and remainder of n / d in one pass. The quotient is 
+// truncated toward zero and the remainder takes the sign of n. The results 
+// are allocated into *q and *r, either may be NULL if it isn't needed. Returns 
+// 0 on success, -1 if n or d is NULL, d is zero, or malloc fails
+int divmod(BigInt* n, BigInt* d, BigInt** q, BigInt** r);
+
+// Creates a new big int with the quotient n / d. Returns NULL if d is zero
+BigInt* divide(BigInt* n, BigInt* d);
+
+// Creates a new big int with the remainder n % d. Returns NULL if d is zero
+BigInt* mod(BigInt* n, BigInt* d);
+
+/*
+ * The batch functions compute count independent items dest[i] = b1[i] op b2[i]
+ * in one call, without the per call allocation of add, subtract and multiply.
+ * Every dest[i] must already exist and may be b1[i] or b2[i], but no other 
+ * item's operand. Each dest grows as add_into would, and long batches are 
+ * split across the threads of BigInt_set_threads. Return 0, or -1 if any
+ * argument is NULL or memory couldn't be allocated
+ */
+int add_batch(BigInt* const* dest, BigInt* const* b1, BigInt* const* b2, 
+              size_t count);
+int subtract_batch(BigInt* const* dest, BigInt* const* b1, BigInt* const* b2, 
+                   size_t count);
+int multiply_batch(BigInt* const* dest, BigInt* const* b1, BigInt* const* b2, 
+                   size_t count);
+
+/*
+ * BigIntMontCtx holds the precomputed constants and scratch space for repeated
+ * arithmetic modulo one odd modulus in Montgomery form. The mont functions 
+ * operate on little endian bucket arrays of exactly mont_buckets(ctx) buckets
+ * holding values below the modulus, dest may alias the operands. After the
+ * context is created they do not allocate, a context for a modulus of 
+ * NTT_THRESHOLD buckets or more also holds the buffers of its transforms. A 
+ * context is not thread safe
+ */
+typedef struct BigIntMontCtx BigIntMontCtx;
+
+// Returns a context for modulus, NULL if modulus is NULL, even or malloc fails
+BigIntMontCtx* new_mont_ctx(BigInt* modulus);
+
+void free_mont_ctx(BigIntMontCtx* ctx);
+
+// Returns the bucket length of the context's operands. 0 if ctx is NULL
+size_t mont_buckets(BigIntMontCtx* ctx);
+
+// dest = a * b * R^-1 mod modulus, the Montgomery product. Returns dest or
+// NULL if any argument is NULL
+bucket_t* mont_mul(BigIntMontCtx* ctx, bucket_t* dest, const bucket_t* a, 
+                   const bucket_t* b);
+
+// dest = a * a * R^-1 mod modulus
+bucket_t* mont_sqr(BigIntMontCtx* ctx, bucket_t* dest, const bucket_t* a);
+
+// dest = a * R mod modulus, converts a into Montgomery form
+bucket_t* to_mont(BigIntMontCtx* ctx, bucket_t* dest, const bucket_t* a);
+
+// dest = a * R^-1 mod modulus, converts a out of Montgomery form
+bucket_t* from_mont(BigIntMontCtx* ctx, bucket_t* dest, const bucket_t* a);
+
+/*
+ * BigIntBarrettCtx holds a precomputed reciprocal of a modulus, which may be 
+ * even, so each reduction costs two multiplications and a subtraction instead
+ * of a division. Like mod the remainder takes the sign of num. A context is 
+ * not thread safe
+ */
+typedef struct BigIntBarrettCtx BigIntBarrettCtx;
+
+// Returns a context for modulus, NULL if modulus is NULL, zero or malloc fails
+BigIntBarrettCtx* new_barrett_ctx(BigInt* modulus);
+
+void free_barrett_ctx(BigIntBarrettCtx* ctx);
+
+// Creates a new big int with the remainder num % modulus
+BigInt* barrett_mod(BigIntBarrettCtx* ctx, BigInt* num);
+
+// Reduces num by the modulus in place, returns num
+BigInt* barrett_mod_into(BigIntBarrettCtx* ctx, BigInt* num);
+
+// powmod flag, selects a fixed window exponentiation whose sequence of 
+// operations and memory accesses only depend on the bucket length of exp and
+// of the modulus. Its products stay on the schoolbook kernels, so it's slower
+// than the sliding window from KARATSUBA_THRESHOLD buckets
+#define POWMOD_CONSTANT_TIME 1
+
+// Creates a new big int with base^exp mod modulus in [0, |modulus|). Odd
+// moduli use Montgomery multiplication, even moduli Barrett reduction. The
+// exponent is scanned with a sliding window unless flags has 
+// POWMOD_CONSTANT_TIME, which requires an odd modulus. Returns NULL if any
+// argument is NULL, exp is negative, modulus is zero or malloc fails
+BigInt* powmod(BigInt* base, BigInt* exp, BigInt* modulus, int flags);
+
+/*
+ * BigInt256, BigInt512 and BigInt1024 are fixed width unsigned integers. Their
+ * buckets live in the struct, least significant first, so they can sit on the
+ * stack and their operations never allocate. Like the unsigned C types they
+ * wrap modulo 2^bits. add and subtract return the carry or borrow out of the
+ * top bucket, and multiply keeps the low bits while multiply_wide keeps the
+ * whole product. compare returns -1, 0 or 1 after looking at every bucket.
+ * dest may alias the operands. The value arrays can be passed to the mont
+ * functions of a context with as many buckets
+ *
+ * to_BigIntN copies a BigInt into dest. It returns 0, or -1 if an argument is
+ * NULL or num is negative or too wide. from_BigIntN returns a new BigInt, or
+ * NULL if num is NULL or malloc fails
+ */
+#define FIXED_BIGINT_BUCKETS(bits) ((bits) / BUCKET_WIDTH)
+
+#define DECLARE_FIXED_BIGINT(bits)                                             \
+    typedef struct BigInt##bits                                                \
+    {                                                                          \
+        bucket_t value[FIXED_BIGINT_BUCKETS(bits)];                            \
+    } BigInt##bits;                                                            \
+                                                                               \
+    bucket_t add_BigInt##bits(BigInt##bits* dest, const BigInt##bits* a,       \
+                              const BigInt##bits* b);                          \
+    bucket_t subtract_BigInt##bits(BigInt##bits* dest, const BigInt##bits* a,  \
+                                   const BigInt##bits* b);                     \
+    void multiply_BigInt##bits(BigInt##bits* dest, const BigInt##bits* a,      \
+                               const BigInt##bits* b);                         \
+    int compare_BigInt##bits(const BigInt##bits* a, const BigInt##bits* b);    \
+    int to_BigInt##bits(BigInt##bits* dest, BigInt* num);                      \
+    BigInt* from_BigInt##bits(const BigInt##bits* num);
+
+DECLARE_FIXED_BIGINT(256)
+DECLARE_FIXED_BIGINT(512)
+DECLARE_FIXED_BIGINT(1024)
+
+void multiply_wide_BigInt256(BigInt512* dest, const BigInt256* a,
+                             const BigInt256* b);
+void multiply_wide_BigInt512(BigInt1024* dest, const BigInt512* a,
+                             const BigInt512* b);
+
 void free_BigInt(BigInt* num);
 
 void display(BigInt* num);
 
+// Returns the buffer size to_string needs for num in base, counting the sign
+// and the null terminator. It may exceed the written length by a few digits.
+// Returns 0 if num is NULL or base is not 2 to 36
+size_t to_string_length(BigInt* num, int base);
+
+// Writes num in base 2 to 36 to buf as lower case digits with a leading '-' 
+// if negative, the format str_base_BigInt reads. Only values past 
+// RADIX_DC_THRESHOLD buckets in a base that isn't a power of two allocate
+// working space. Returns the length written, not counting the terminator, or 
+// 0 if num or buf is NULL, base is invalid, len is less than
+// to_string_length(num, base) or malloc fails
+size_t to_string(BigInt* num, int base, char* buf, size_t len);
+
+// Returns the number of bytes in the magnitude of num, 1 for zero. Returns 0 
+// if num is NULL
+size_t byte_length(BigInt* num);
+
+// Writes the magnitude of num to buf in byte_length(num) bytes, the sign is
+// not stored. Returns the number of bytes written, or 0 if num or buf is NULL
+// or len is less than byte_length(num)
+size_t export_bytes(BigInt* num, uint8_t* buf, size_t len, int endian);
+
+// Writes num to file in the versioned binary format, a header followed by 
+// the buckets. Returns 0 on success, -1 if num or file is NULL or a write fails
+int save_BigInt(BigInt* num, FILE* file);
+
+// Reads a BigInt written by save_BigInt under any platform from file. Returns
+// NULL if file is NULL, the header is invalid, the file is short or malloc 
+// fails
+BigInt* load_BigInt(FILE* file);
+
+// Returns the BigInt saved at path. When the file has this platform's bucket
+// width on a little endian host its buckets are mapped instead of read, the 
+// mapping is private so in place arithmetic never changes the file and it is
+// unmapped by free_BigInt. Other files are read like load_BigInt. Returns 
+// NULL if the file can't be opened or is invalid
+BigInt* map_BigInt(const char* path);
+
+/*
+ * Every allocation BigInt makes, BigInts and scratch buffers alike, goes
+ * through the functions set by BigInt_set_allocator. They keep the contract of
+ * malloc, realloc and free. Passing any NULL restores the C library's. The
+ * allocator is shared by all threads and should only be changed while no
+ * BigInt is in use, a BigInt must be freed by the allocator that made it
+ *
+ * BigInt_arena_malloc, BigInt_arena_realloc and BigInt_arena_free form a bump
+ * allocator with a pool per thread. Freeing only reclaims the latest
+ * allocation, BigInt_arena_reset reclaims everything the calling thread
+ * allocated at once and keeps its pool for reuse, so every BigInt it made
+ * must be dropped first. BigInt_arena_release returns the calling thread's
+ * pool to the system. The worker threads of BigInt_set_threads take the 
+ * scratch space of their share of an operation from pools of their own, 
+ * which are rewound after every task and released when the workers stop. 
+ * Scratch the calling thread frees out of order while waiting for workers is
+ * only reclaimed by its next BigInt_arena_reset
+ */
+typedef void* (*BigInt_malloc_fn)(size_t size);
+typedef void* (*BigInt_realloc_fn)(void* ptr, size_t size);
+typedef void (*BigInt_free_fn)(void* ptr);
+
+void BigInt_set_allocator(BigInt_malloc_fn malloc_fn, BigInt_realloc_fn realloc_fn,
+                          BigInt_free_fn free_fn);
+
+void* BigInt_arena_malloc(size_t size);
+void* BigInt_arena_realloc(void* ptr, size_t size);
+void BigInt_arena_free(void* ptr);
+void BigInt_arena_reset(void);
+void BigInt_arena_release(void);
+
+/*
+ * The innermost loops, adding, subtracting and multiplying rows of buckets,
+ * have one implementation per instruction set. The best one the CPU supports
+ * is picked when the library loads. On x64 CPUs with BMI2 and ADX, 
+ * BIGINT_KERNELS_ADX multiplies with mulx, adcx and adox, and 
+ * BIGINT_KERNELS_AVX512 adds to that vector additions and subtractions of 
+ * long rows for CPUs with AVX-512. BigInt_set_kernels forces a set and 
+ * returns 0, or -1 if the set isn't supported and selects the best one.
+ * Like the allocator the kernels are shared by all threads and should only be
+ * changed while no BigInt is in use
+ */
+#define BIGINT_KERNELS_AUTO 0
+#define BIGINT_KERNELS_GENERIC 1
+#define BIGINT_KERNELS_ADX 2
+#define BIGINT_KERNELS_AVX512 3
+
+int BigInt_set_kernels(int kernels);
+
+// Returns the selected set, never BIGINT_KERNELS_AUTO
+int BigInt_get_kernels(void);
+
+/*
+ * Multiplications of long operands, and the divisions built on them, can 
+ * split their independent sub products and transforms across threads. 
+ * BigInt_set_threads(n) starts a pool of n - 1 worker threads that help the 
+ * calling thread, 0 uses one thread per online processor and 1, the default,
+ * stops the pool. The results are identical to the single threaded ones. 
+ * Returns 0, or -1 if the threads couldn't be started and the pool is left 
+ * stopped. The pool is shared by all threads and should only be changed while
+ * no BigInt is in use
+ */
+int BigInt_set_threads(size_t threads);
+
+// Returns the number of threads multiplications use, at least 1
+size_t BigInt_get_threads(void);
+
 // Returns number of allocated buckets. 0 if num is NULL
 int buckets(BigInt* num);
 
@@ -94,6 +427,11 @@ int compare_int(BigInt* lhs, sbucket_t rhs);
 int compare_uint(BigInt* lhs, bucket_t rhs);
 int compare_bigint(BigInt* lhs, BigInt* rhs);
 
+// results[i] = compare_bigint(lhs[i], rhs[i]) for every i < count. Returns 0,
+// or -1 if any argument is NULL
+int compare_batch(int* results, BigInt* const* lhs, BigInt* const* rhs, 
+                  size_t count);
+
 #ifdef MOCKING_ENABLED
 // mock_bigint allows static functions and private members to be visible during
 // unit tests
@@ -101,6 +439,8 @@ typedef struct mock_bigint {
     int (*char_to_num)(char, int);
     int (*format_string)(const char*, const char**, const char**);
     bucket_t (*add_carry)(bucket_t* carry_in, bucket_t b1, bucket_t b2);
+    bucket_t (*mul_add_carry)(bucket_t* carry, bucket_t b1, bucket_t b2, 
+                              bucket_t addend);
     bucket_t* (*get_buckets)(BigInt* num);
 } mock_bigint;
 
@@ -50,6 +50,9 @@ workspace "BigInt"
             "-Wall", "-Wextra", "-Werror"
         }
 
+    filter "system:not windows"
+        links "pthread"
+
     filter {} -- close filter
 
 project "BigInt"
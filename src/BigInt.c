@@ -13,494 +13,5354 @@
 #include <stdlib.h>
 #include "BigInt.h"
 
+// Hex strings are validated and converted 16 or 32 characters at a time with 
+// SSE2 or AVX2 when the CPU has them, the scalar loops remain the fallback
+#if ( defined( __x86_64__ ) || defined( __i386__ ) ) && defined( __GNUC__ )
+    #define BIGINT_HEX_SIMD
+    #include <immintrin.h>
+#endif
+
+// map_BigInt maps saved files where mmap is available and reads them elsewhere
+#if defined( __unix__ ) || defined( __APPLE__ )
+    #define BIGINT_MMAP
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+// Values of up to 128 bits are kept in the BigInt itself, so constructing one
+// takes a single allocation
+#define INLINE_BUCKETS (16 / sizeof(bucket_t))
+
 // TODO inspect padding
 struct BigInt
 {
     bucket_t* value;
     size_t nbuckets;
+    size_t length; // Buckets up to the leading non zero one, at least 1
     int8_t sign;
+    uint8_t storage; // Who releases value, one of the bucket_storage values
+    bucket_t inline_buckets[INLINE_BUCKETS];
+};
+
+// value is allocated by BigInt, belongs to the caller of view_BigInt, lies in 
+// a file mapped by map_BigInt, or is inline_buckets while nbuckets fits there
+enum bucket_storage { BUCKETS_OWNED, BUCKETS_BORROWED, BUCKETS_MAPPED, 
+                      BUCKETS_INLINE };
+
+// Buffers a context preallocates for its products. While a context's product
+// runs it stays on the calling thread, which needs no scratch of its own, and
+// a transform of ntt_length reuses ntt_memory of (NTT_PRIMES + 2) * 
+// ntt_length words instead of allocating
+typedef struct product_workspace
+{
+    uint32_t* ntt_memory;
+    size_t ntt_length; // 0 if the context's products never use the NTT
+} product_workspace;
+
+// Precomputed state for arithmetic modulo an odd modulus in Montgomery form,
+// a value x is represented by x * R mod modulus with R = B^nbuckets
+struct BigIntMontCtx
+{
+    bucket_t* modulus;
+    bucket_t* r_squared;
+    bucket_t* scratch;
+    product_workspace products;
+    size_t nbuckets;
+    bucket_t inverse; // -modulus^-1 mod B
+};
+
+// Precomputed state for reducing by any non zero modulus of nbuckets buckets,
+// reciprocal is floor(B^2nbuckets / modulus)
+struct BigIntBarrettCtx
+{
+    bucket_t* modulus;
+    bucket_t* reciprocal;
+    bucket_t* scratch;
+    product_workspace products; // The products vary in length, no NTT buffers
+    size_t nbuckets;
+    size_t reciprocal_buckets;
 };
 
+// dbucket_t is wide enough to hold the full product of two buckets. It is used
+// by the portable kernels when inline assembly is not available
+#if defined( BIGINT__8bit )
+    typedef uint16_t dbucket_t;
+#elif defined( BIGINT__x64 )
+    typedef unsigned __int128 dbucket_t;
+#else // BIGINT__x86
+    typedef uint64_t dbucket_t;
+#endif
+
 /*******************************************************************************
-* STATIC MEMBER FUNCTIONS
+* ALLOCATION
 *******************************************************************************/
-static int count_hex_digits(bucket_t num)
-{
-    if(num == 0)
-    {
-        return 1;
-    }
 
-    //stackoverflow.com/questions/9721042/
-    //count-number-of-digits-which-method-is-most-efficient/
-    // There was a number of different methodoligies suggested, this one was
-    // the easiest to implement
-#ifdef BIGINT__x64
-    return snprintf(NULL, 0, "%lx", num);
+#if defined( _MSC_VER )
+    #define BIGINT_THREAD_LOCAL __declspec( thread )
+#elif defined( __GNUC__ )
+    #define BIGINT_THREAD_LOCAL __thread
 #else
-    return snprintf(NULL, 0, "%x", num);
+    #define BIGINT_THREAD_LOCAL _Thread_local
 #endif
+
+// Every allocation BigInt makes goes through these, see BigInt_set_allocator
+static BigInt_malloc_fn bigint_malloc = malloc;
+static BigInt_realloc_fn bigint_realloc = realloc;
+static BigInt_free_fn bigint_free = free;
+
+void BigInt_set_allocator(BigInt_malloc_fn malloc_fn, BigInt_realloc_fn realloc_fn,
+                          BigInt_free_fn free_fn)
+{
+    int complete = malloc_fn != NULL && realloc_fn != NULL && free_fn != NULL;
+    bigint_malloc = complete ? malloc_fn : malloc;
+    bigint_realloc = complete ? realloc_fn : realloc;
+    bigint_free = complete ? free_fn : free;
+    return;
 }
 
-static int hex_value(char c)
+// The arena carves allocations out of blocks of at least ARENA_BLOCK bytes,
+// each allocation is preceded by ARENA_ALIGN bytes holding its size so it 
+// can be reallocated
+#define ARENA_BLOCK ((size_t) 1 << 20)
+#define ARENA_ALIGN ((size_t) 16)
+
+typedef struct arena_block
 {
-    return (c >= '0' && c <= '9') ? c - '0' :
-           ((c = tolower(c)) >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+    struct arena_block* next;
+    size_t size; // Bytes after the block header
+    size_t used;
+    size_t last; // Offset of the latest allocation, the one that can be freed
+} arena_block;
+
+#define ARENA_HEADER ((sizeof(arena_block) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+// The calling thread's blocks in order and the one allocations come from. 
+// Blocks past the current one are left over from before a reset
+static BIGINT_THREAD_LOCAL arena_block* arena_first = NULL;
+static BIGINT_THREAD_LOCAL arena_block* arena_current = NULL;
+
+static uint8_t* arena_data(arena_block* block)
+{
+    return (uint8_t*) block + ARENA_HEADER;
 }
 
-static int iszero(int c)
+// Returns the arena bytes taken by an allocation of size, 0 if a block that
+// large can't be allocated
+static size_t arena_footprint(size_t size)
 {
-    return c == '0';
+    if(size > SIZE_MAX - ARENA_HEADER - 2 * ARENA_ALIGN)
+    {
+        return 0;
+    }
+    return ARENA_ALIGN + ((size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1));
 }
 
-static const char* strip_character(const char* str, int (*istarget)(int c))
+void* BigInt_arena_malloc(size_t size)
 {
-    if(str)
+    size_t footprint = arena_footprint(size);
+    if(footprint == 0)
     {
-        while(istarget(*str))
+        return NULL;
+    }
+
+    arena_block* block = arena_current;
+    while(block != NULL && block->size - block->used < footprint)
+    {
+        block = block->next;
+    }
+    if(block == NULL)
+    {
+        size_t block_size = (footprint > ARENA_BLOCK) ? footprint : ARENA_BLOCK;
+        block = (arena_block*) malloc(ARENA_HEADER + block_size);
+        if(block == NULL)
         {
-            ++str;
+            return NULL;
+        }
+        block->size = block_size;
+        block->used = 0;
+        block->last = 0;
+
+        // Linked after the current block so the blocks past it are still reused
+        block->next = (arena_current != NULL) ? arena_current->next : NULL;
+        if(arena_current != NULL)
+        {
+            arena_current->next = block;
+        }
+        else
+        {
+            arena_first = block;
         }
     }
-    return str;
+    arena_current = block;
+
+    uint8_t* header = arena_data(block) + block->used;
+    memcpy(header, &size, sizeof(size));
+    block->last = block->used;
+    block->used += footprint;
+    return header + ARENA_ALIGN;
 }
 
-static const char* strip_negative_and_store(const char* str, int* sign)
+void* BigInt_arena_realloc(void* ptr, size_t size)
 {
-    if(str && *str == '-')
+    if(ptr == NULL)
     {
-        *sign = -1;
-        ++str;
+        return BigInt_arena_malloc(size);
     }
-    return str;
+
+    uint8_t* header = (uint8_t*) ptr - ARENA_ALIGN;
+    size_t old_size;
+    memcpy(&old_size, header, sizeof(old_size));
+
+    // The latest allocation is resized in place when its block has room
+    arena_block* block = arena_current;
+    size_t footprint = arena_footprint(size);
+    if(block != NULL && footprint != 0 && header == arena_data(block) + block->last &&
+       footprint <= block->size - block->last)
+    {
+        block->used = block->last + footprint;
+        memcpy(header, &size, sizeof(size));
+        return ptr;
+    }
+
+    void* moved = BigInt_arena_malloc(size);
+    if(moved != NULL)
+    {
+        memcpy(moved, ptr, (old_size < size) ? old_size : size);
+    }
+    return moved;
 }
 
-static const char* strip_hex_prefix(const char* str)
+void BigInt_arena_free(void* ptr)
 {
-    if(str && *str == '0' && *(str + 1) == 'x')
+    // Only the latest allocation is handed back, which covers the scratch 
+    // buffers of every operation. The rest waits for BigInt_arena_reset
+    arena_block* block = arena_current;
+    if(ptr != NULL && block != NULL && 
+       (uint8_t*) ptr == arena_data(block) + block->last + ARENA_ALIGN)
     {
-        str += 2;
+        block->used = block->last;
     }
-    return str;
+    return;
 }
 
-// Points start to the first character of the string, and end to the last
-static int format_string(const char* str, const char** start, const char** end)
+void BigInt_arena_reset(void)
 {
-    if(str && start && end)
+    for(arena_block* block = arena_first; block != NULL; block = block->next)
     {
-        int sign = 1;
-
-        // Strips white space, strips negative and stores into sign, strips
-        // hex prefix, then finally strips leading zeroes
-        str = strip_negative_and_store(strip_character(str, isspace), &sign);
-        str = strip_character(strip_hex_prefix(str), iszero);
-
-        if (*str == '\0') // String is invalid
-        {
-            return 0;
-        }
-
-        *start = str;
-
-        // sets end pointer to one past last alphanumeric character
-        *end = strip_character(str, isxdigit);
-        return (**end == '\0' || isspace(**end)) ? sign : 0;
+        block->used = 0;
+        block->last = 0;
     }
-    return 0;
+    arena_current = arena_first;
+    return;
 }
 
-static bucket_t* allocate_buckets(size_t buckets)
+void BigInt_arena_release(void)
 {
-    bucket_t* bucket = (bucket_t*) malloc(sizeof(bucket_t) * buckets);
-    for (bucket_t i = 0; i < buckets; ++i)
+    while(arena_first != NULL)
     {
-        bucket[i] = 0;
+        arena_block* next = arena_first->next;
+        free(arena_first);
+        arena_first = next;
     }
-    return bucket;
+    arena_current = NULL;
+    return;
 }
 
-static const char* fill_buckets(const char* start, const char* end, 
-                                bucket_t* buckets, size_t* nbuckets)
+/*******************************************************************************
+* THREADS
+*******************************************************************************/
+
+/*
+ * parallel_run hands all but the first of a group of independent tasks to the
+ * workers started by BigInt_set_threads and runs the first itself. Queued 
+ * tasks are taken latest first, and a thread waiting for its group runs 
+ * whichever tasks are queued instead of sleeping, so groups nested inside 
+ * tasks can't leave the pool blocked on each other. The pool's bookkeeping 
+ * outlives any allocator and uses the C library directly
+ */
+#if defined( __unix__ ) || defined( __APPLE__ )
+    #define BIGINT_THREADS
+    #include <pthread.h>
+    #include <unistd.h>
+#endif
+
+// The most tasks in one parallel_run
+#define PARALLEL_MAX_TASKS 8
+
+typedef void (*task_fn)(void* arg);
+
+#ifdef BIGINT_THREADS
+
+typedef struct parallel_task
 {
-        bucket_t bucket = 0;
-        int digits_per_bucket = 2 * sizeof(bucket_t);
-        int digits_to_process = (start != end) ? digits_per_bucket : 0;
+    task_fn run;
+    void* arg;
+    size_t* pending; // Unfinished tasks of the group
+    struct parallel_task* next;
+} parallel_task;
 
-        for (; start < end; ++start)
-        {
-            int digit = hex_value(*start);
-            // digit will always be valid, string was checked for non hex digits 
+// pool_changed is signalled whenever a task is queued or finishes and when
+// the pool stops
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_changed = PTHREAD_COND_INITIALIZER;
+static parallel_task* pool_queue = NULL;
+static pthread_t* pool_workers = NULL;
+static size_t pool_size = 0;
+static int pool_stopping = 0;
 
-            bucket = (bucket << 4) | digit;
+// Runs the latest queued task, pool_lock is held except while the task runs
+static void run_queued_task(void)
+{
+    parallel_task* task = pool_queue;
+    pool_queue = task->next;
 
-            if(--digits_to_process == 0)
-            {
-                // Dump bucket
-                buckets[--(*nbuckets)] = bucket;
-                bucket = 0;
+    pthread_mutex_unlock(&pool_lock);
+    task->run(task->arg);
+    pthread_mutex_lock(&pool_lock);
 
-                // Don't reset counter if this is the last iteration
-                digits_to_process = (start + 1 != end) ? digits_per_bucket : 0;
-            }
+    --*task->pending;
+    pthread_cond_broadcast(&pool_changed);
+    return;
+}
+
+static void* pool_worker(void* unused)
+{
+    (void) unused;
+
+    pthread_mutex_lock(&pool_lock);
+    while(!pool_stopping)
+    {
+        if(pool_queue != NULL)
+        {
+            run_queued_task();
+
+            // A task only takes scratch space, including that of the groups 
+            // nested in it, which the worker's arena can't all reclaim by 
+            // freeing. Nothing else can reset it, so it is rewound here
+            BigInt_arena_reset();
         }
-        if(digits_to_process > 0)
+        else
         {
-            // Dump remaining values in bucket
-            buckets[--(*nbuckets)] = bucket;
+            pthread_cond_wait(&pool_changed, &pool_lock);
         }
-        return start;
+    }
+    pthread_mutex_unlock(&pool_lock);
+
+    // Scratch space a task took from the worker's arena would otherwise leak
+    BigInt_arena_release();
+    return NULL;
 }
 
-static size_t leading_bucket(BigInt* num)
+static void stop_pool(void)
 {
-    if(num)
+    pthread_mutex_lock(&pool_lock);
+    pool_stopping = 1;
+    pthread_cond_broadcast(&pool_changed);
+    pthread_mutex_unlock(&pool_lock);
+
+    for(size_t i = 0; i < pool_size; ++i)
     {
-        size_t lead_bucket = num->nbuckets;
-        while(num->value[--lead_bucket] == 0 && lead_bucket > 0);
-        return ++lead_bucket;
+        pthread_join(pool_workers[i], NULL);
     }
-    return 0;
+    free(pool_workers);
+    pool_workers = NULL;
+    pool_size = 0;
+    pool_stopping = 0;
+    return;
 }
 
-static void display_bucket(bucket_t val)
+#endif // BIGINT_THREADS
+
+int BigInt_set_threads(size_t threads)
 {
-#ifdef BIGINT__x86
-    printf("%0*x", 2 * (int) sizeof(bucket_t), val);
+#ifdef BIGINT_THREADS
+    if(threads == 0)
+    {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = (online > 1) ? (size_t) online : 1;
+    }
+    stop_pool();
+    if(threads == 1)
+    {
+        return 0;
+    }
+
+    pool_workers = (pthread_t*) malloc((threads - 1) * sizeof(pthread_t));
+    if(pool_workers == NULL)
+    {
+        return -1;
+    }
+    for(; pool_size < threads - 1; ++pool_size)
+    {
+        if(pthread_create(&pool_workers[pool_size], NULL, pool_worker, NULL) != 0)
+        {
+            stop_pool();
+            return -1;
+        }
+    }
+    return 0;
 #else
-    // Cast is used so 8bit debug build can use the %lx formatter
-    printf("%0*lx", 2 * (int) sizeof(bucket_t), (uint64_t) val);
+    return (threads <= 1) ? 0 : -1;
 #endif
-    return;
 }
 
-// reverse for each
-static void rfor_each(bucket_t* buckets, int nbuckets, void(*action)(bucket_t val))
+size_t BigInt_get_threads(void)
 {
-    for(;nbuckets >= 0; --nbuckets)
-    {
-        action(buckets[nbuckets]);
-    }
-    return;
+#ifdef BIGINT_THREADS
+    return pool_size + 1;
+#else
+    return 1;
+#endif
 }
 
-static void grow_BigInt(BigInt* num, int delta)
+// Runs run on each of the count <= PARALLEL_MAX_TASKS arguments of size bytes
+// starting at args and returns once they have all finished
+static void parallel_run(task_fn run, void* args, size_t size, size_t count)
 {
-    if(delta >= 0)
+    char* arg = (char*) args;
+#ifdef BIGINT_THREADS
+    if(pool_size > 0 && count > 1)
     {
-        size_t index = num->nbuckets;
-        num->nbuckets += delta;
+        parallel_task tasks[PARALLEL_MAX_TASKS];
+        size_t pending = count - 1;
+
+        pthread_mutex_lock(&pool_lock);
+        for(size_t i = 1; i < count; ++i)
+        {
+            tasks[i].run = run;
+            tasks[i].arg = arg + i * size;
+            tasks[i].pending = &pending;
+            tasks[i].next = pool_queue;
+            pool_queue = &tasks[i];
+        }
+        pthread_cond_broadcast(&pool_changed);
+        pthread_mutex_unlock(&pool_lock);
 
-        num->value = (bucket_t*) realloc(num->value, num->nbuckets * sizeof(bucket_t));
+        run(arg);
 
-        for(size_t i = index; i < num->nbuckets; ++i)
+        pthread_mutex_lock(&pool_lock);
+        while(pending > 0)
         {
-            num->value[i] = 0;
+            if(pool_queue != NULL)
+            {
+                run_queued_task();
+            }
+            else
+            {
+                pthread_cond_wait(&pool_changed, &pool_lock);
+            }
         }
+        pthread_mutex_unlock(&pool_lock);
+        return;
+    }
+#endif
+    for(size_t i = 0; i < count; ++i)
+    {
+        run(arg + i * size);
     }
     return;
 }
 
 /*******************************************************************************
-* CONSTRUCTORS
+* STATIC MEMBER FUNCTIONS
 *******************************************************************************/
-
-BigInt* reserve_BigInt(bucket_t buckets)
+static int count_hex_digits(bucket_t num)
 {
-    BigInt* new_int = (BigInt*) malloc(sizeof(BigInt));
-    if(new_int)
+    if(num == 0)
     {
-        new_int->value = allocate_buckets(buckets);
-        new_int->nbuckets = buckets;
-        new_int->sign = 1;
+        return 1;
     }
-    return new_int;
+
+    //stackoverflow.com/questions/9721042/
+    //count-number-of-digits-which-method-is-most-efficient/
+    // There was a number of different methodoligies suggested, this one was
+    // the easiest to implement
+#ifdef BIGINT__x64
+    return snprintf(NULL, 0, "%lx", num);
+#else
+    return snprintf(NULL, 0, "%x", num);
+#endif
 }
 
-BigInt* empty_BigInt() 
+static int hex_value(char c)
 {
-    return reserve_BigInt(1);
+    return (c >= '0' && c <= '9') ? c - '0' :
+           ((c = tolower(c)) >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
 }
 
-BigInt* val_BigInt(bucket_t num)
+// Returns the value of c as a digit of base, -1 if c isn't a digit of base
+static int char_to_num(char c, int base)
 {
-    BigInt* new_int = reserve_BigInt(1);
-    if(new_int)
+    c = tolower(c);
+
+    // Default base is 10
+    base = (base < 2 || base > 36) ? 10 : base;
+
+    char upper_alphabetic_limit = 'a' + base - 11;
+    char upper_numeric_limit = (base < 10) ? '0' + base - 1 : '9';
+
+    return (c >= '0' && c <= upper_numeric_limit)   ? c - '0' :
+           (c >= 'a'&& c <= upper_alphabetic_limit) ? c - 'a' + 10 : -1;
+}
+
+// Returns the number of hex digits at the start of str[0..n)
+static size_t hex_span_scalar(const char* str, size_t n)
+{
+    size_t i = 0;
+    for(; i < n && hex_value(str[i]) >= 0; ++i);
+    return i;
+}
+
+// Stores a 64 bit value into the 64 / BUCKET_WIDTH buckets below nbuckets, 
+// most significant first like fill_buckets
+static void store_u64(bucket_t* buckets, size_t* nbuckets, uint64_t value)
+{
+    for(int shift = 64 - BUCKET_WIDTH; shift >= 0; shift -= BUCKET_WIDTH)
     {
-        new_int->value[0] = num;
+        buckets[--(*nbuckets)] = (bucket_t) (value >> shift);
     }
-    return new_int;
+    return;
 }
 
-BigInt* str_BigInt(const char* str_num)
+// Returns the 64 bits of x[0..n) starting at bit 64 * index
+static uint64_t load_u64(const bucket_t* x, size_t n, size_t index)
 {
-    const char* start = NULL;
-    const char* end = NULL;
-    int8_t sign = format_string(str_num, &start, &end);
-    
-    if(sign == 0) // format_string failed, do not parse string
+    uint64_t value = 0;
+    size_t per_u64 = 64 / BUCKET_WIDTH;
+    for(size_t i = 0; i < per_u64 && index * per_u64 + i < n; ++i)
     {
-        return empty_BigInt();
+        value |= (uint64_t) x[index * per_u64 + i] << (i * BUCKET_WIDTH);
     }
+    return value;
+}
 
-    size_t digits = end - start;
-    size_t digits_per_bucket = 2 * sizeof(bucket_t); 
-    size_t nbuckets = (digits + digits_per_bucket - 1) / digits_per_bucket;
+#ifdef BIGINT_HEX_SIMD
 
-    BigInt* new_int = reserve_BigInt(nbuckets);
-    if(new_int)
-    {
-        new_int->sign = sign;
-        const char* overhang = start + (digits % digits_per_bucket);
+/*
+ * Each character c is a digit if '0' <= c <= '9' or 'a' <= (c | 0x20) <= 'f', 
+ * setting bit 5 lower cases letters and leaves digits unchanged. Bytes past 
+ * 0x7f are negative as signed bytes and fail both ranges. Pairs of nibbles 
+ * are merged into bytes inside each 16 bit lane and packed, which leaves the 
+ * value in big endian order
+ */
 
-        // Fills buckets from start - overhang then from overhang to end
-        fill_buckets(fill_buckets(start, overhang, new_int->value, &nbuckets), 
-                     end, new_int->value, &nbuckets);
-    }
-    return new_int;
+// Returns 2 if the CPU has AVX2, 1 if it has SSE2 and 0 otherwise
+static int hex_simd_level(void)
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? 2 : __builtin_cpu_supports("sse2");
 }
 
-/*******************************************************************************
-* ARITHMETIC
+__attribute__((target("sse2")))
+static __m128i hex_digits_sse2(__m128i c, __m128i* nibbles)
+{
+    __m128i lower = _mm_or_si128(c, _mm_set1_epi8(0x20));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)),
+                                  _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+    __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                  _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+
+    *nibbles = _mm_or_si128(
+        _mm_and_si128(digit, _mm_sub_epi8(c, _mm_set1_epi8('0'))),
+        _mm_andnot_si128(digit, _mm_sub_epi8(lower, _mm_set1_epi8('a' - 10))));
+    return _mm_or_si128(digit, alpha);
+}
+
+__attribute__((target("sse2")))
+static size_t hex_span_sse2(const char* str, size_t n)
+{
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+    {
+        __m128i nibbles;
+        __m128i c = _mm_loadu_si128((const __m128i*) (str + i));
+        unsigned valid = _mm_movemask_epi8(hex_digits_sse2(c, &nibbles));
+        if(valid != 0xffff)
+        {
+            return i + __builtin_ctz(~valid);
+        }
+    }
+    return i + hex_span_scalar(str + i, n - i);
+}
+
+// Converts 16 hex digits per iteration, returns the first unconverted digit
+__attribute__((target("sse2")))
+static const char* fill_buckets_sse2(const char* start, const char* end, 
+                                     bucket_t* buckets, size_t* nbuckets)
+{
+    for(; end - start >= 16; start += 16)
+    {
+        __m128i nibbles;
+        hex_digits_sse2(_mm_loadu_si128((const __m128i*) start), &nibbles);
+
+        __m128i high = _mm_and_si128(_mm_slli_epi16(nibbles, 4), _mm_set1_epi16(0xf0));
+        __m128i bytes = _mm_or_si128(high, _mm_srli_epi16(nibbles, 8));
+
+        uint64_t value;
+        _mm_storel_epi64((__m128i*) &value, _mm_packus_epi16(bytes, bytes));
+        store_u64(buckets, nbuckets, __builtin_bswap64(value));
+    }
+    return start;
+}
+
+// Converts 32 hex digits per iteration. The pack works within each 128 bit 
+// lane, so the two values are the low 64 bits of each lane
+__attribute__((target("avx2")))
+static const char* fill_buckets_avx2(const char* start, const char* end, 
+                                     bucket_t* buckets, size_t* nbuckets)
+{
+    for(; end - start >= 32; start += 32)
+    {
+        __m256i c = _mm256_loadu_si256((const __m256i*) start);
+        __m256i lower = _mm256_or_si256(c, _mm256_set1_epi8(0x20));
+        __m256i digit = _mm256_and_si256(
+            _mm256_cmpgt_epi8(c, _mm256_set1_epi8('0' - 1)),
+            _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), c));
+        __m256i nibbles = _mm256_blendv_epi8(
+            _mm256_sub_epi8(lower, _mm256_set1_epi8('a' - 10)),
+            _mm256_sub_epi8(c, _mm256_set1_epi8('0')), digit);
+
+        __m256i high = _mm256_and_si256(_mm256_slli_epi16(nibbles, 4), 
+                                        _mm256_set1_epi16(0xf0));
+        __m256i bytes = _mm256_or_si256(high, _mm256_srli_epi16(nibbles, 8));
+
+        uint64_t values[4];
+        _mm256_storeu_si256((__m256i*) values, _mm256_packus_epi16(bytes, bytes));
+        store_u64(buckets, nbuckets, __builtin_bswap64(values[0]));
+        store_u64(buckets, nbuckets, __builtin_bswap64(values[2]));
+    }
+    return fill_buckets_sse2(start, end, buckets, nbuckets);
+}
+
+// Writes the 16 hex digits of value to out
+__attribute__((target("sse2")))
+static void write_hex_sse2(char* out, uint64_t value)
+{
+    value = __builtin_bswap64(value);
+    __m128i bytes = _mm_loadl_epi64((const __m128i*) &value);
+    __m128i high = _mm_and_si128(_mm_srli_epi16(bytes, 4), _mm_set1_epi8(0x0f));
+    __m128i low = _mm_and_si128(bytes, _mm_set1_epi8(0x0f));
+    __m128i nibbles = _mm_unpacklo_epi8(high, low);
+
+    __m128i letters = _mm_and_si128(_mm_cmpgt_epi8(nibbles, _mm_set1_epi8(9)),
+                                    _mm_set1_epi8('a' - '0' - 10));
+    _mm_storeu_si128((__m128i*) out, _mm_add_epi8(nibbles, 
+                     _mm_add_epi8(letters, _mm_set1_epi8('0'))));
+    return;
+}
+
+// Writes the 32 hex digits of high:low to out. Widening each byte to 16 bits
+// lets both of its nibbles be placed in order with two shifts
+__attribute__((target("avx2")))
+static void write_hex_avx2(char* out, uint64_t high, uint64_t low)
+{
+    __m128i bytes = _mm_set_epi64x((long long) __builtin_bswap64(low), 
+                                   (long long) __builtin_bswap64(high));
+    __m256i wide = _mm256_cvtepu8_epi16(bytes);
+    __m256i nibbles = _mm256_or_si256(_mm256_srli_epi16(wide, 4),
+        _mm256_slli_epi16(_mm256_and_si256(wide, _mm256_set1_epi16(0x0f)), 8));
+
+    __m256i letters = _mm256_and_si256(
+        _mm256_cmpgt_epi8(nibbles, _mm256_set1_epi8(9)), 
+        _mm256_set1_epi8('a' - '0' - 10));
+    _mm256_storeu_si256((__m256i*) out, _mm256_add_epi8(nibbles, 
+                        _mm256_add_epi8(letters, _mm256_set1_epi8('0'))));
+    return;
+}
+
+#endif // BIGINT_HEX_SIMD
+
+// Returns the number of hex digits at the start of str
+static size_t hex_span(const char* str)
+{
+    size_t n = strlen(str);
+#ifdef BIGINT_HEX_SIMD
+    if(hex_simd_level() > 0)
+    {
+        return hex_span_sse2(str, n);
+    }
+#endif
+    return hex_span_scalar(str, n);
+}
+
+// Writes the hex digits of the groups of 64 bits of x[0..n) below the most
+// significant group, out holds digits characters. Returns the number of 
+// digits written, the remaining leading digits are left to the caller
+static size_t write_hex_groups(char* out, const bucket_t* x, size_t n, 
+                               size_t digits)
+{
+    size_t groups = (digits - 1) / 16;
+#ifdef BIGINT_HEX_SIMD
+    int level = hex_simd_level();
+    size_t g = 0;
+    for(; level == 2 && g + 2 <= groups; g += 2)
+    {
+        write_hex_avx2(out + digits - 16 * (g + 2), load_u64(x, n, g + 1), 
+                       load_u64(x, n, g));
+    }
+    for(; level > 0 && g < groups; ++g)
+    {
+        write_hex_sse2(out + digits - 16 * (g + 1), load_u64(x, n, g));
+    }
+    return 16 * g;
+#else
+    (void) out; (void) x; (void) n; (void) groups;
+    return 0;
+#endif
+}
+
+static int iszero(int c)
+{
+    return c == '0';
+}
+
+static const char* strip_character(const char* str, int (*istarget)(int c))
+{
+    if(str)
+    {
+        while(istarget(*str))
+        {
+            ++str;
+        }
+    }
+    return str;
+}
+
+static const char* strip_negative_and_store(const char* str, int* sign)
+{
+    if(str && *str == '-')
+    {
+        *sign = -1;
+        ++str;
+    }
+    return str;
+}
+
+static const char* strip_hex_prefix(const char* str)
+{
+    if(str && *str == '0' && *(str + 1) == 'x')
+    {
+        str += 2;
+    }
+    return str;
+}
+
+// Points start to the first digit of the string in base, and end to one past
+// the last. Returns the sign of the string, 0 if it is invalid
+static int format_base_string(const char* str, int base, const char** start, 
+                              const char** end)
+{
+    if(str && start && end)
+    {
+        int sign = 1;
+
+        // Strips white space, strips negative and stores into sign, strips
+        // hex prefix, then finally strips leading zeroes
+        str = strip_negative_and_store(strip_character(str, isspace), &sign);
+        str = (base == 16) ? strip_hex_prefix(str) : str;
+        str = strip_character(str, iszero);
+
+        if (*str == '\0') // String is invalid
+        {
+            return 0;
+        }
+
+        *start = str;
+
+        // sets end pointer to one past last digit of base
+        if(base == 16)
+        {
+            str += hex_span(str);
+        }
+        for(; char_to_num(*str, base) >= 0; ++str);
+        *end = str;
+        return (**end == '\0' || isspace(**end)) ? sign : 0;
+    }
+    return 0;
+}
+
+// Points start to the first character of the string, and end to the last
+static int format_string(const char* str, const char** start, const char** end)
+{
+    return format_base_string(str, 16, start, end);
+}
+
+static bucket_t* allocate_buckets(size_t buckets)
+{
+    bucket_t* bucket = (bucket_t*) bigint_malloc(sizeof(bucket_t) * buckets);
+    for (size_t i = 0; bucket && i < buckets; ++i)
+    {
+        bucket[i] = 0;
+    }
+    return bucket;
+}
+
+static const char* fill_buckets(const char* start, const char* end, 
+                                bucket_t* buckets, size_t* nbuckets)
+{
+#ifdef BIGINT_HEX_SIMD
+        // Blocks of 16 digits fill whole buckets. The partial leading bucket
+        // is passed separately and is always shorter than a block
+        int level = hex_simd_level();
+        start = (level == 2) ? fill_buckets_avx2(start, end, buckets, nbuckets) :
+                (level == 1) ? fill_buckets_sse2(start, end, buckets, nbuckets) : 
+                               start;
+#endif
+
+        bucket_t bucket = 0;
+        int digits_per_bucket = 2 * sizeof(bucket_t);
+        int digits_to_process = (start != end) ? digits_per_bucket : 0;
+
+        for (; start < end; ++start)
+        {
+            int digit = hex_value(*start);
+            // digit will always be valid, string was checked for non hex digits 
+
+            bucket = (bucket << 4) | digit;
+
+            if(--digits_to_process == 0)
+            {
+                // Dump bucket
+                buckets[--(*nbuckets)] = bucket;
+                bucket = 0;
+
+                // Don't reset counter if this is the last iteration
+                digits_to_process = (start + 1 != end) ? digits_per_bucket : 0;
+            }
+        }
+        if(digits_to_process > 0)
+        {
+            // Dump remaining values in bucket
+            buckets[--(*nbuckets)] = bucket;
+        }
+        return start;
+}
+
+static size_t leading_bucket(BigInt* num)
+{
+    return (num != NULL) ? num->length : 0;
+}
+
+// Recounts the length of num after its buckets were written, every bucket 
+// from top up must already be zero
+static BigInt* trim_BigInt(BigInt* num, size_t top)
+{
+    while(top > 1 && num->value[top - 1] == 0)
+    {
+        --top;
+    }
+    num->length = (top > 0) ? top : 1;
+    return num;
+}
+
+// Returns non zero if every bucket of num is zero
+static int equals_zero(BigInt* num)
+{
+    return leading_bucket(num) == 1 && num->value[0] == 0;
+}
+
+// Compares the magnitudes of two normalized bucket arrays. Returns 0 if equal,
+// -1 if b1 < b2 and 1 if b1 > b2
+static int compare_buckets(const bucket_t* b1, size_t n1, 
+                           const bucket_t* b2, size_t n2)
+{
+    if(n1 != n2)
+    {
+        return (n1 < n2) ? -1 : 1;
+    }
+    while(n1-- > 0)
+    {
+        if(b1[n1] != b2[n1])
+        {
+            return (b1[n1] < b2[n1]) ? -1 : 1;
+        }
+    }
+    return 0;
+}
+
+static void release_buckets(BigInt* num);
+
+// Installs value as the buckets of num and releases the old buckets
+static void replace_buckets(BigInt* num, bucket_t* value, size_t nbuckets)
+{
+    release_buckets(num);
+    num->value = value;
+    num->nbuckets = nbuckets;
+    num->storage = BUCKETS_OWNED;
+    return;
+}
+
+// Moves the buckets of num into an allocation of capacity buckets, which 
+// must hold its length. Returns 0 and leaves num alone if malloc fails
+static int resize_buckets(BigInt* num, size_t capacity)
+{
+    bucket_t* value;
+    if(capacity <= INLINE_BUCKETS)
+    {
+        // Small enough to move back into the BigInt itself
+        if(num->storage != BUCKETS_INLINE)
+        {
+            memcpy(num->inline_buckets, num->value, num->length * sizeof(bucket_t));
+            release_buckets(num);
+            num->value = num->inline_buckets;
+            num->storage = BUCKETS_INLINE;
+        }
+    }
+    else if(num->storage == BUCKETS_OWNED)
+    {
+        value = (bucket_t*) bigint_realloc(num->value, capacity * sizeof(bucket_t));
+        if(value == NULL)
+        {
+            return 0;
+        }
+        num->value = value;
+    }
+    else
+    {
+        // A view, a mapping or inline buckets can't be resized, they become a 
+        // copy that owns its buckets
+        value = (bucket_t*) bigint_malloc(capacity * sizeof(bucket_t));
+        if(value == NULL)
+        {
+            return 0;
+        }
+        memcpy(value, num->value, num->length * sizeof(bucket_t));
+        replace_buckets(num, value, capacity);
+    }
+
+    memset(num->value + num->length, 0, 
+           (capacity - num->length) * sizeof(bucket_t));
+    num->nbuckets = capacity;
+    return 1;
+}
+
+// Makes room for at least needed buckets. The capacity grows by at least half
+// each time, so an accumulator that keeps carrying out reallocates O(log n) 
+// times. Returns 0 if malloc fails
+static int grow_BigInt(BigInt* num, size_t needed)
+{
+    if(needed <= num->nbuckets)
+    {
+        return 1;
+    }
+    size_t capacity = num->nbuckets + num->nbuckets / 2;
+    return resize_buckets(num, (capacity > needed) ? capacity : needed);
+}
+
+/*******************************************************************************
+* CONSTRUCTORS
+*******************************************************************************/
+
+BigInt* reserve_BigInt(size_t buckets)
+{
+    BigInt* new_int = (BigInt*) bigint_malloc(sizeof(BigInt));
+    if(new_int)
+    {
+        if(buckets <= INLINE_BUCKETS)
+        {
+            memset(new_int->inline_buckets, 0, sizeof(new_int->inline_buckets));
+            new_int->value = new_int->inline_buckets;
+            new_int->storage = BUCKETS_INLINE;
+        }
+        else
+        {
+            new_int->value = allocate_buckets(buckets);
+            new_int->storage = BUCKETS_OWNED;
+        }
+        new_int->nbuckets = buckets;
+        new_int->length = 1;
+        new_int->sign = 1;
+    }
+    return new_int;
+}
+
+BigInt* empty_BigInt() 
+{
+    return reserve_BigInt(1);
+}
+
+BigInt* val_BigInt(bucket_t num)
+{
+    BigInt* new_int = reserve_BigInt(1);
+    if(new_int)
+    {
+        new_int->value[0] = num;
+    }
+    return new_int;
+}
+
+BigInt* str_BigInt(const char* str_num)
+{
+    const char* start = NULL;
+    const char* end = NULL;
+    int8_t sign = format_string(str_num, &start, &end);
+    
+    if(sign == 0) // format_string failed, do not parse string
+    {
+        return empty_BigInt();
+    }
+
+    size_t digits = end - start;
+    size_t digits_per_bucket = 2 * sizeof(bucket_t); 
+    size_t nbuckets = (digits + digits_per_bucket - 1) / digits_per_bucket;
+
+    BigInt* new_int = reserve_BigInt(nbuckets);
+    if(new_int)
+    {
+        new_int->sign = sign;
+        const char* overhang = start + (digits % digits_per_bucket);
+
+        // Fills buckets from start - overhang then from overhang to end
+        fill_buckets(fill_buckets(start, overhang, new_int->value, &nbuckets), 
+                     end, new_int->value, &nbuckets);
+        trim_BigInt(new_int, new_int->nbuckets);
+    }
+    return new_int;
+}
+
+BigInt* view_BigInt(bucket_t* buckets, size_t nbuckets)
+{
+    if(buckets == NULL || nbuckets == 0)
+    {
+        return NULL;
+    }
+
+    BigInt* new_int = (BigInt*) bigint_malloc(sizeof(BigInt));
+    if(new_int)
+    {
+        new_int->value = buckets;
+        new_int->nbuckets = nbuckets;
+        new_int->sign = 1;
+        new_int->storage = BUCKETS_BORROWED;
+        trim_BigInt(new_int, nbuckets);
+    }
+    return new_int;
+}
+
+/*******************************************************************************
+* ARITHMETIC
+*******************************************************************************/
+
+#if defined( BIGINT__x64 ) && !defined( __clang__ )
+
+static bucket_t add_with_carry(bucket_t *carry, bucket_t b1, bucket_t b2) 
+{
+    bucket_t sum;
+    bucket_t carry_in = *carry;
+    uint8_t carry_out;
+
+    asm(
+        "xorq	%0, %0\n\t"
+        "cmpq   %4, %0\n\t"
+        "movq	%2, %0\n\t"
+        "adcq	%3, %0\n\t"
+        "setc	%1\n\t"
+        : "=&rm" (sum), "=&rm"(carry_out)
+        : "rm" (b1), "rm" (b2), "r" (carry_in)
+        : "cc"
+    );
+
+    *carry = carry_out;
+    return sum;
+}
+
+static bucket_t subtract_with_carry(bucket_t* carry, bucket_t b1, bucket_t b2)
+{
+    bucket_t sum;
+    bucket_t carry_in = *carry;
+    uint8_t carry_out;
+
+    asm(
+        "xorq	%0, %0\n\t"
+        "cmpq   %4, %0\n\t"
+        "movq	%2, %0\n\t"
+        "sbbq	%3, %0\n\t"
+        "setc	%1\n\t"
+        : "=&rm" (sum), "=&rm"(carry_out)
+        : "rm" (b1), "rm" (b2), "r" (carry_in)
+        : "cc"
+    );
+
+    *carry = carry_out;
+    return sum;
+}
+
+// Returns the low half of (b1 * b2) + addend + carry, stores the high half in
+// carry. The sum can never overflow two buckets
+static bucket_t mul_add_with_carry(bucket_t* carry, bucket_t b1, bucket_t b2,
+                                   bucket_t addend)
+{
+    bucket_t low;
+    bucket_t high;
+
+    asm(
+        "mulq	%3\n\t"
+        "addq	%4, %0\n\t"
+        "adcq	$0, %1\n\t"
+        "addq	%5, %0\n\t"
+        "adcq	$0, %1\n\t"
+        : "=a" (low), "=&d" (high)
+        : "0" (b1), "rm" (b2), "rm" (addend), "rm" (*carry)
+        : "cc"
+    );
+
+    *carry = high;
+    return low;
+}
+
+// Returns the two bucket value high:low divided by divisor and stores the 
+// remainder. high must be less than divisor so the quotient fits in a bucket
+static bucket_t divide_with_remainder(bucket_t* remainder, bucket_t high,
+                                      bucket_t low, bucket_t divisor)
+{
+    bucket_t quotient;
+
+    asm(
+        "divq	%4\n\t"
+        : "=a" (quotient), "=d" (*remainder)
+        : "0" (low), "1" (high), "rm" (divisor)
+        : "cc"
+    );
+
+    return quotient;
+}
+
+#elif defined( BIGINT__x86 ) && !defined( __clang__ )
+
+static bucket_t add_with_carry(bucket_t *carry, bucket_t b1, bucket_t b2) 
+{
+    bucket_t sum;
+    bucket_t carry_in = *carry;
+    uint8_t carry_out;
+
+    asm(
+        "xorl	%0, %0\n\t"
+        "cmpl   %4, %0\n\t"
+        "movl	%2, %0\n\t"
+        "adcl	%3, %0\n\t"
+        "setc	%1\n\t"
+        : "=&rm" (sum), "=&rm"(carry_out)
+        : "rm" (b1), "rm" (b2), "r" (carry_in)
+        : "cc"
+    );
+
+    *carry = carry_out;
+    return sum;
+}
+
+static bucket_t subtract_with_carry(bucket_t* carry, bucket_t b1, bucket_t b2)
+{
+    bucket_t sum;
+    bucket_t carry_in = *carry;
+    uint8_t carry_out;
+
+    asm(
+        "xorl	%0, %0\n\t"
+        "cmpl   %4, %0\n\t"
+        "movl	%2, %0\n\t"
+        "sbbl	%3, %0\n\t"
+        "setc	%1\n\t"
+        : "=&rm" (sum), "=&rm"(carry_out)
+        : "rm" (b1), "rm" (b2), "r" (carry_in)
+        : "cc"
+    );
+
+    *carry = carry_out;
+    return sum;}
+
+// Returns the low half of (b1 * b2) + addend + carry, stores the high half in
+// carry. The sum can never overflow two buckets
+static bucket_t mul_add_with_carry(bucket_t* carry, bucket_t b1, bucket_t b2,
+                                   bucket_t addend)
+{
+    bucket_t low;
+    bucket_t high;
+
+    asm(
+        "mull	%3\n\t"
+        "addl	%4, %0\n\t"
+        "adcl	$0, %1\n\t"
+        "addl	%5, %0\n\t"
+        "adcl	$0, %1\n\t"
+        : "=a" (low), "=&d" (high)
+        : "0" (b1), "rm" (b2), "rm" (addend), "rm" (*carry)
+        : "cc"
+    );
+
+    *carry = high;
+    return low;
+}
+
+// Returns the two bucket value high:low divided by divisor and stores the 
+// remainder. high must be less than divisor so the quotient fits in a bucket
+static bucket_t divide_with_remainder(bucket_t* remainder, bucket_t high,
+                                      bucket_t low, bucket_t divisor)
+{
+    bucket_t quotient;
+
+    asm(
+        "divl	%4\n\t"
+        : "=a" (quotient), "=d" (*remainder)
+        : "0" (low), "1" (high), "rm" (divisor)
+        : "cc"
+    );
+
+    return quotient;
+}
+
+#else // defined( BIGINT__8bit ) || defined ( __clang__ )
+
+// clang, and GCC from 14, have add and subtract with carry builtins that 
+// compile to adc and sbb where the target has them
+#if defined( __has_builtin )
+    #if defined( BIGINT__8bit ) && __has_builtin( __builtin_addcb )
+        #define BUILTIN_ADDC __builtin_addcb
+        #define BUILTIN_SUBC __builtin_subcb
+        typedef unsigned char builtin_carry_t;
+    #elif defined( BIGINT__x64 ) && __has_builtin( __builtin_addcll )
+        #define BUILTIN_ADDC __builtin_addcll
+        #define BUILTIN_SUBC __builtin_subcll
+        typedef unsigned long long builtin_carry_t;
+    #elif defined( BIGINT__x86 ) && __has_builtin( __builtin_addc )
+        #define BUILTIN_ADDC __builtin_addc
+        #define BUILTIN_SUBC __builtin_subc
+        typedef unsigned int builtin_carry_t;
+    #endif
+#endif
+
+#ifdef BUILTIN_ADDC
+
+static bucket_t add_with_carry(bucket_t* carry, bucket_t b1, bucket_t b2) 
+{
+    builtin_carry_t carry_out;
+    bucket_t sum = (bucket_t) BUILTIN_ADDC(b1, b2, *carry, &carry_out);
+
+    *carry = (bucket_t) carry_out;
+
+    return sum;
+}
+
+static bucket_t subtract_with_carry(bucket_t* carry, bucket_t b1, bucket_t b2)
+{
+    builtin_carry_t carry_out;
+    bucket_t difference = (bucket_t) BUILTIN_SUBC(b1, b2, *carry, &carry_out);
+
+    *carry = (bucket_t) carry_out;
+
+    return difference;
+}
+
+#else
+
+static bucket_t add_with_carry(bucket_t* carry, bucket_t b1, bucket_t b2) 
+{
+    bucket_t sum = b1;
+
+    uint8_t carry_in = (sum += *carry) < b1 ? 1 : 0;
+
+    uint8_t carry_out = (sum += b2) < b2 ? 1 : carry_in;
+
+    *carry = carry_out;
+
+    return sum;
+}
+
+static bucket_t subtract_with_carry(bucket_t* carry, bucket_t b1, bucket_t b2)
+{
+    bucket_t sum = b1;
+
+    uint8_t carry_in = (sum -= *carry) > b1 ? 1 : 0;
+
+    uint8_t carry_out = sum < b2 ? 1 : carry_in;
+
+    *carry = carry_out;
+
+    return sum - b2;
+}
+
+#endif // BUILTIN_ADDC
+
+// Returns the low half of (b1 * b2) + addend + carry, stores the high half in
+// carry. The sum can never overflow two buckets
+static bucket_t mul_add_with_carry(bucket_t* carry, bucket_t b1, bucket_t b2,
+                                   bucket_t addend)
+{
+    dbucket_t product = (dbucket_t) b1 * b2 + addend + *carry;
+
+    *carry = (bucket_t) (product >> BUCKET_WIDTH);
+
+    return (bucket_t) product;
+}
+
+// Returns the two bucket value high:low divided by divisor and stores the 
+// remainder. high must be less than divisor so the quotient fits in a bucket
+static bucket_t divide_with_remainder(bucket_t* remainder, bucket_t high,
+                                      bucket_t low, bucket_t divisor)
+{
+    dbucket_t dividend = ((dbucket_t) high << BUCKET_WIDTH) | low;
+
+    *remainder = (bucket_t) (dividend % divisor);
+
+    return (bucket_t) (dividend / divisor);
+}
+
+#endif
+
+/*
+ * Bucket array kernels. Each kernel operates on raw little endian bucket arrays
+ * and returns the carry out of the most significant bucket. Destination arrays
+ * must not partially overlap the sources.
+ */
+
+/*
+ * The hottest kernels are called through a table of implementations, chosen
+ * when the library loads from the instructions the CPU has. The generic set 
+ * runs everywhere, on x64 the ADX set multiplies with mulx and the two carry
+ * chains of adcx and adox. BigInt_set_kernels can force either
+ */
+typedef struct bucket_kernels
+{
+    bucket_t (*add_n)(bucket_t*, const bucket_t*, const bucket_t*, size_t);
+    bucket_t (*sub_n)(bucket_t*, const bucket_t*, const bucket_t*, size_t);
+    bucket_t (*mul_1)(bucket_t*, const bucket_t*, size_t, bucket_t);
+    bucket_t (*addmul_1)(bucket_t*, const bucket_t*, size_t, bucket_t);
+    void (*sqr_basecase)(bucket_t*, const bucket_t*, size_t);
+} bucket_kernels;
+
+static const bucket_kernels generic_kernels;
+static const bucket_kernels* kernels = &generic_kernels;
+
+// On x86 the carry of add_n and sub_n stays in the carry flag across an adc or
+// sbb chain unrolled 4 buckets deep, lea and dec leave the flag alone. The
+// mnemonics take their width from the bucket register, so one loop serves 
+// both bucket widths. The chain runs over blocks groups of 4 buckets and 
+// leaves dest, b1 and b2 past them, digit and chain_carry are its scratch
+#if ( defined( BIGINT__x64 ) || defined( BIGINT__x86 ) ) && defined( __GNUC__ ) \
+    && ( defined( __x86_64__ ) || defined( __i386__ ) )
+    #define CARRY_CHAIN(op)                                                    \
+        "clc\n\t"                                                              \
+        "1:\n\t"                                                               \
+        "mov	(%[b1]), %[digit]\n\t"                                          \
+        op "	(%[b2]), %[digit]\n\t"                                          \
+        "mov	%[digit], (%[dest])\n\t"                                        \
+        "mov	%c[width](%[b1]), %[digit]\n\t"                                 \
+        op "	%c[width](%[b2]), %[digit]\n\t"                                 \
+        "mov	%[digit], %c[width](%[dest])\n\t"                               \
+        "mov	2*%c[width](%[b1]), %[digit]\n\t"                               \
+        op "	2*%c[width](%[b2]), %[digit]\n\t"                               \
+        "mov	%[digit], 2*%c[width](%[dest])\n\t"                             \
+        "mov	3*%c[width](%[b1]), %[digit]\n\t"                               \
+        op "	3*%c[width](%[b2]), %[digit]\n\t"                               \
+        "mov	%[digit], 3*%c[width](%[dest])\n\t"                             \
+        "lea	4*%c[width](%[b1]), %[b1]\n\t"                                  \
+        "lea	4*%c[width](%[b2]), %[b2]\n\t"                                  \
+        "lea	4*%c[width](%[dest]), %[dest]\n\t"                              \
+        "dec	%[blocks]\n\t"                                                  \
+        "jnz	1b\n\t"                                                         \
+        "setc	%[carry]\n\t"                                                   \
+        : [dest] "+r" (dest), [b1] "+r" (b1), [b2] "+r" (b2),                  \
+          [blocks] "+r" (blocks), [digit] "=&r" (digit),                       \
+          [carry] "=qm" (chain_carry)                                          \
+        : [width] "i" (sizeof(bucket_t))                                       \
+        : "cc", "memory"
+#endif
+
+// dest[0..n) = b1[0..n) + b2[0..n)
+static bucket_t add_n_generic(bucket_t* dest, const bucket_t* b1, 
+                              const bucket_t* b2, size_t n)
+{
+    bucket_t carry = 0;
+#ifdef CARRY_CHAIN
+    size_t blocks = n / 4;
+    if(blocks > 0)
+    {
+        bucket_t digit;
+        uint8_t chain_carry;
+        asm volatile(CARRY_CHAIN("adc"));
+        carry = chain_carry;
+        n %= 4;
+    }
+#endif
+    for(size_t i = 0; i < n; ++i)
+    {
+        dest[i] = add_with_carry(&carry, b1[i], b2[i]);
+    }
+    return carry;
+}
+
+// dest[0..n) = b1[0..n) - b2[0..n), returns the borrow
+static bucket_t sub_n_generic(bucket_t* dest, const bucket_t* b1, 
+                              const bucket_t* b2, size_t n)
+{
+    bucket_t carry = 0;
+#ifdef CARRY_CHAIN
+    size_t blocks = n / 4;
+    if(blocks > 0)
+    {
+        bucket_t digit;
+        uint8_t chain_carry;
+        asm volatile(CARRY_CHAIN("sbb"));
+        carry = chain_carry;
+        n %= 4;
+    }
+#endif
+    for(size_t i = 0; i < n; ++i)
+    {
+        dest[i] = subtract_with_carry(&carry, b1[i], b2[i]);
+    }
+    return carry;
+}
+
+static bucket_t add_n(bucket_t* dest, const bucket_t* b1, const bucket_t* b2, 
+                      size_t n)
+{
+    return kernels->add_n(dest, b1, b2, n);
+}
+
+static bucket_t sub_n(bucket_t* dest, const bucket_t* b1, const bucket_t* b2, 
+                      size_t n)
+{
+    return kernels->sub_n(dest, b1, b2, n);
+}
+
+// dest[0..n) = src[0..n) + val
+static bucket_t add_1(bucket_t* dest, const bucket_t* src, size_t n, 
+                      bucket_t val)
+{
+    size_t i = 0;
+    for(; i < n && val != 0; ++i)
+    {
+        dest[i] = src[i] + val;
+        val = (dest[i] < val) ? 1 : 0;
+    }
+    if(dest != src && i < n)
+    {
+        memcpy(dest + i, src + i, (n - i) * sizeof(bucket_t));
+    }
+    return val;
+}
+
+// dest[0..n) = src[0..n) - val, returns the borrow
+static bucket_t sub_1(bucket_t* dest, const bucket_t* src, size_t n, 
+                      bucket_t val)
+{
+    size_t i = 0;
+    for(; i < n && val != 0; ++i)
+    {
+        bucket_t digit = src[i];
+        dest[i] = digit - val;
+        val = (digit < val) ? 1 : 0;
+    }
+    if(dest != src && i < n)
+    {
+        memcpy(dest + i, src + i, (n - i) * sizeof(bucket_t));
+    }
+    return val;
+}
+
+// dest[0..n1) = b1[0..n1) + b2[0..n2), n1 >= n2
+static bucket_t add_buckets(bucket_t* dest, const bucket_t* b1, size_t n1,
+                            const bucket_t* b2, size_t n2)
+{
+    return add_1(dest + n2, b1 + n2, n1 - n2, add_n(dest, b1, b2, n2));
+}
+
+// dest[0..n1) = b1[0..n1) - b2[0..n2), n1 >= n2. Returns the borrow
+static bucket_t subtract_buckets(bucket_t* dest, const bucket_t* b1, size_t n1,
+                                 const bucket_t* b2, size_t n2)
+{
+    return sub_1(dest + n2, b1 + n2, n1 - n2, sub_n(dest, b1, b2, n2));
+}
+
+// dest[0..n) = src[0..n) * factor
+static bucket_t mul_1_generic(bucket_t* dest, const bucket_t* src, size_t n, 
+                              bucket_t factor)
+{
+    bucket_t carry = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        dest[i] = mul_add_with_carry(&carry, src[i], factor, 0);
+    }
+    return carry;
+}
+
+// dest[0..n) += src[0..n) * factor
+static bucket_t addmul_1_generic(bucket_t* dest, const bucket_t* src, size_t n, 
+                                 bucket_t factor)
+{
+    bucket_t carry = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        dest[i] = mul_add_with_carry(&carry, src[i], factor, dest[i]);
+    }
+    return carry;
+}
+
+static bucket_t mul_1(bucket_t* dest, const bucket_t* src, size_t n, 
+                      bucket_t factor)
+{
+    return kernels->mul_1(dest, src, n, factor);
+}
+
+static bucket_t addmul_1(bucket_t* dest, const bucket_t* src, size_t n, 
+                         bucket_t factor)
+{
+    return kernels->addmul_1(dest, src, n, factor);
+}
+
+// dest[0..n) -= src[0..n) * factor, returns the amount borrowed
+static bucket_t submul_1(bucket_t* dest, const bucket_t* src, size_t n, 
+                         bucket_t factor)
+{
+    bucket_t carry = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        bucket_t borrow = 0;
+        bucket_t product = mul_add_with_carry(&carry, src[i], factor, 0);
+
+        dest[i] = subtract_with_carry(&borrow, dest[i], product);
+
+        // The high half of a product is never BUCKET_MAX when a borrow occurs
+        carry += borrow;
+    }
+    return carry;
+}
+
+// Adds src into dest[offset..n), carries out of dest are discarded
+static void add_at(bucket_t* dest, size_t n, size_t offset, 
+                   const bucket_t* src, size_t nsrc)
+{
+    size_t len = (nsrc < n - offset) ? nsrc : n - offset;
+    bucket_t carry = add_n(dest + offset, dest + offset, src, len);
+
+    add_1(dest + offset + len, dest + offset + len, n - offset - len, carry);
+    return;
+}
+
+// dest[0..n1) = |b1[0..n1) - b2[0..n2)|, n1 >= n2. Returns 1 if b1 < b2
+static int absolute_difference(bucket_t* dest, const bucket_t* b1, size_t n1,
+                               const bucket_t* b2, size_t n2)
+{
+    size_t lead = n1;
+    while(lead > n2 && b1[lead - 1] == 0)
+    {
+        --lead;
+    }
+    if(lead == n2 && compare_buckets(b1, n2, b2, n2) < 0)
+    {
+        sub_n(dest, b2, b1, n2);
+        memset(dest + n2, 0, (n1 - n2) * sizeof(bucket_t));
+        return 1;
+    }
+    subtract_buckets(dest, b1, n1, b2, n2);
+    return 0;
+}
+
+// dest[0..n) = src[0..n) << count with 0 < count < BUCKET_WIDTH. Returns the 
+// bits shifted out of the top bucket, dest may be src
+static bucket_t lshift(bucket_t* dest, const bucket_t* src, size_t n, 
+                       unsigned count)
+{
+    bucket_t out = src[n - 1] >> (BUCKET_WIDTH - count);
+    for(size_t i = n - 1; i > 0; --i)
+    {
+        dest[i] = (bucket_t) (src[i] << count) | 
+                  (src[i - 1] >> (BUCKET_WIDTH - count));
+    }
+    dest[0] = (bucket_t) (src[0] << count);
+    return out;
+}
+
+// dest[0..n) = src[0..n) >> count with 0 < count < BUCKET_WIDTH. Returns the 
+// bits shifted out of the bottom bucket in the high bits, dest may be src
+static bucket_t rshift(bucket_t* dest, const bucket_t* src, size_t n, 
+                       unsigned count)
+{
+    bucket_t out = (bucket_t) (src[0] << (BUCKET_WIDTH - count));
+    for(size_t i = 0; i + 1 < n; ++i)
+    {
+        dest[i] = (src[i] >> count) | 
+                  (bucket_t) (src[i + 1] << (BUCKET_WIDTH - count));
+    }
+    dest[n - 1] = src[n - 1] >> count;
+    return out;
+}
+
+// Number of leading zero bits in a non zero bucket
+static unsigned count_leading_zeros(bucket_t val)
+{
+#if defined( __GNUC__ )
+    return __builtin_clzll(val) - (64 - BUCKET_WIDTH);
+#else
+    unsigned count = 0;
+    for(; !(val & ((bucket_t) 1 << (BUCKET_WIDTH - 1))); val <<= 1)
+    {
+        ++count;
+    }
+    return count;
+#endif
+}
+
+// Two's complement negation of a bucket array
+static void negate_buckets(bucket_t* buckets, size_t n)
+{
+    for(size_t i = 0; i < n; ++i)
+    {
+        buckets[i] = ~buckets[i];
+    }
+    add_1(buckets, buckets, n, 1);
+    return;
+}
+
+// Arithmetic shift right by one bit of a two's complement bucket array
+static void halve_signed(bucket_t* buckets, size_t n)
+{
+    for(size_t i = 0; i + 1 < n; ++i)
+    {
+        buckets[i] = (buckets[i] >> 1) | 
+                     (bucket_t) (buckets[i + 1] << (BUCKET_WIDTH - 1));
+    }
+    bucket_t sign_bit = buckets[n - 1] & ((bucket_t) 1 << (BUCKET_WIDTH - 1));
+    buckets[n - 1] = (buckets[n - 1] >> 1) | sign_bit;
+    return;
+}
+
+// Divides a two's complement bucket array that is a multiple of 3 by 3. Exact
+// division is a multiplication by the inverse of 3 modulo the bucket base
+static void divide_exact_by_3(bucket_t* buckets, size_t n)
+{
+    const bucket_t inverse = (BUCKET_MAX_SIZE / 3) * 2 + 1;
+
+    bucket_t borrow = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        bucket_t high = 0;
+        bucket_t under = 0;
+        bucket_t digit = subtract_with_carry(&under, buckets[i], borrow);
+
+        buckets[i] = (bucket_t) (digit * inverse);
+
+        mul_add_with_carry(&high, buckets[i], 3, 0);
+        borrow = high + under;
+    }
+    return;
+}
+
+// Schoolbook multiplication, dest[0..n1 + n2) = b1[0..n1) * b2[0..n2). Every
+// row is accumulated with a single fused multiply-add carry chain
+static void mul_basecase(bucket_t* dest, const bucket_t* b1, size_t n1, 
+                         const bucket_t* b2, size_t n2)
+{
+    dest[n1] = mul_1(dest, b1, n1, b2[0]);
+    for(size_t i = 1; i < n2; ++i)
+    {
+        dest[n1 + i] = addmul_1(dest + i, b1, n1, b2[i]);
+    }
+    return;
+}
+
+// Schoolbook squaring, dest[0..2n) = b[0..n)^2. Only the products above the
+// diagonal are computed, they are doubled and the squares of each bucket on
+// the diagonal are added
+static void sqr_basecase_generic(bucket_t* dest, const bucket_t* b, size_t n)
+{
+    dest[0] = 0;
+    dest[2 * n - 1] = 0;
+    if(n > 1)
+    {
+        dest[n] = mul_1(dest + 1, b + 1, n - 1, b[0]);
+        for(size_t i = 1; i + 1 < n; ++i)
+        {
+            dest[n + i] = addmul_1(dest + 2 * i + 1, b + i + 1, n - i - 1, b[i]);
+        }
+        dest[2 * n - 1] = lshift(dest + 1, dest + 1, 2 * n - 2, 1);
+    }
+
+    bucket_t carry = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+        bucket_t high = 0;
+        bucket_t low = mul_add_with_carry(&high, b[i], b[i], 0);
+
+        dest[2 * i] = add_with_carry(&carry, dest[2 * i], low);
+        dest[2 * i + 1] = add_with_carry(&carry, dest[2 * i + 1], high);
+    }
+    return;
+}
+
+#if defined( BIGINT__x64 ) && defined( __x86_64__ ) && defined( __GNUC__ )
+    #define BIGINT_X64_KERNELS
+    #include <cpuid.h>
+    #include <immintrin.h>
+#endif
+
+#ifdef BIGINT_X64_KERNELS
+
+/*
+ * mulx leaves the flags alone, so adcx (the carry flag) adds the high half of
+ * the previous product while adox (the overflow flag) adds dest, two 
+ * independent carry chains. The loops count with lea and jrcxz, which leave
+ * both flags alone, first over the n % 4 leftover buckets and then over
+ * blocks of 4. It needs the locals dest, src, rest, blocks, carry, low and 
+ * high with factor in rdx
+ */
+#define ADX_STEP(offset, accumulate) \
+    "mulx	" #offset "(%[src]), %[low], %[high]\n\t" \
+    "adcx	%[carry], %[low]\n\t" \
+    accumulate \
+    "mov	%[low], " #offset "(%[dest])\n\t" \
+    "mov	%[high], %[carry]\n\t"
+
+#define MUL_STEP(offset) ADX_STEP(offset, "")
+#define ADDMUL_STEP(offset) \
+    ADX_STEP(offset, "adox	" #offset "(%[dest]), %[low]\n\t")
+
+#define ADX_ROW(step) \
+    "xor	%[carry], %[carry]\n\t" \
+    "1:\n\t" \
+    "jrcxz	2f\n\t" \
+    step(0) \
+    "lea	8(%[src]), %[src]\n\t" \
+    "lea	8(%[dest]), %[dest]\n\t" \
+    "lea	-1(%[rest]), %[rest]\n\t" \
+    "jmp	1b\n\t" \
+    "2:\n\t" \
+    "mov	%[blocks], %[rest]\n\t" \
+    "3:\n\t" \
+    "jrcxz	4f\n\t" \
+    step(0) step(8) step(16) step(24) \
+    "lea	32(%[src]), %[src]\n\t" \
+    "lea	32(%[dest]), %[dest]\n\t" \
+    "lea	-1(%[rest]), %[rest]\n\t" \
+    "jmp	3b\n\t" \
+    "4:\n\t" \
+    "mov	$0, %k[low]\n\t"
+
+#define ADX_OPERANDS \
+    : [dest] "+r" (dest), [src] "+r" (src), [rest] "+c" (rest), \
+      [carry] "=&r" (carry), [low] "=&r" (low), [high] "=&r" (high) \
+    : [blocks] "r" (blocks), "d" (factor) \
+    : "cc", "memory"
+
+// dest[0..n) = src[0..n) * factor
+static bucket_t mul_1_adx(bucket_t* dest, const bucket_t* src, size_t n, 
+                          bucket_t factor)
+{
+    size_t rest = n % 4;
+    size_t blocks = n / 4;
+    bucket_t carry;
+    bucket_t low;
+    bucket_t high;
+
+    asm volatile(
+        ADX_ROW(MUL_STEP)
+        "adcx	%[low], %[carry]\n\t"
+        ADX_OPERANDS
+    );
+
+    return carry;
+}
+
+// dest[0..n) += src[0..n) * factor
+static bucket_t addmul_1_adx(bucket_t* dest, const bucket_t* src, size_t n, 
+                             bucket_t factor)
+{
+    size_t rest = n % 4;
+    size_t blocks = n / 4;
+    bucket_t carry;
+    bucket_t low;
+    bucket_t high;
+
+    asm volatile(
+        ADX_ROW(ADDMUL_STEP)
+        "adcx	%[low], %[carry]\n\t"
+        "adox	%[low], %[carry]\n\t"
+        ADX_OPERANDS
+    );
+
+    return carry;
+}
+
+/*
+ * Vector additions add every lane at once and then resolve the carries with
+ * a carry lookahead over the lane masks. A lane generates a carry if its sum
+ * wrapped and propagates one if its sum is all ones, adding the generate mask
+ * shifted up a lane to the propagate mask ripples each carry through the runs
+ * of all ones lanes. Only the mask arithmetic is serial, a few scalar
+ * instructions per vector instead of one adc per bucket. Subtraction is the
+ * same with borrows and all zeros lanes. Shorter rows stay on the adc chain
+ */
+#define VECTOR_ADD_THRESHOLD 64
+
+// Returns the mask of the lanes receiving a carry and updates carry to the 
+// carry out of the lanes
+static unsigned lookahead_carries(unsigned generate, unsigned propagate, 
+                                  unsigned lanes, bucket_t* carry)
+{
+    unsigned sum = ((generate << 1) | (unsigned) *carry) + propagate;
+    *carry = (sum >> lanes) & 1;
+    return (sum ^ propagate) & ((1u << lanes) - 1);
+}
+
+// The sums of 16 buckets are added in two vectors so each lookahead covers 
+// 16 lanes
+__attribute__((target("avx512f")))
+static bucket_t add_n_avx512(bucket_t* dest, const bucket_t* b1, 
+                             const bucket_t* b2, size_t n)
+{
+    if(n < VECTOR_ADD_THRESHOLD)
+    {
+        return add_n_generic(dest, b1, b2, n);
+    }
+
+    const __m512i ones = _mm512_set1_epi64(-1);
+
+    bucket_t carry = 0;
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+    {
+        __m512i a0 = _mm512_loadu_si512(b1 + i);
+        __m512i a1 = _mm512_loadu_si512(b1 + i + 8);
+        __m512i sum0 = _mm512_add_epi64(a0, _mm512_loadu_si512(b2 + i));
+        __m512i sum1 = _mm512_add_epi64(a1, _mm512_loadu_si512(b2 + i + 8));
+        unsigned generate = _mm512_cmplt_epu64_mask(sum0, a0) | 
+                            (unsigned) _mm512_cmplt_epu64_mask(sum1, a1) << 8;
+        unsigned propagate = _mm512_cmpeq_epi64_mask(sum0, ones) | 
+                             (unsigned) _mm512_cmpeq_epi64_mask(sum1, ones) << 8;
+
+        unsigned in = lookahead_carries(generate, propagate, 16, &carry);
+        _mm512_storeu_si512(dest + i, _mm512_mask_sub_epi64(sum0, (__mmask8) in, 
+                                                            sum0, ones));
+        _mm512_storeu_si512(dest + i + 8, _mm512_mask_sub_epi64(sum1, 
+                            (__mmask8) (in >> 8), sum1, ones));
+    }
+    for(; i < n; ++i)
+    {
+        dest[i] = add_with_carry(&carry, b1[i], b2[i]);
+    }
+    return carry;
+}
+
+__attribute__((target("avx512f")))
+static bucket_t sub_n_avx512(bucket_t* dest, const bucket_t* b1, 
+                             const bucket_t* b2, size_t n)
+{
+    if(n < VECTOR_ADD_THRESHOLD)
+    {
+        return sub_n_generic(dest, b1, b2, n);
+    }
+
+    const __m512i ones = _mm512_set1_epi64(-1);
+    const __m512i zero = _mm512_setzero_si512();
+
+    bucket_t borrow = 0;
+    size_t i = 0;
+    for(; i + 16 <= n; i += 16)
+    {
+        __m512i a0 = _mm512_loadu_si512(b1 + i);
+        __m512i a1 = _mm512_loadu_si512(b1 + i + 8);
+        __m512i c0 = _mm512_loadu_si512(b2 + i);
+        __m512i c1 = _mm512_loadu_si512(b2 + i + 8);
+        __m512i diff0 = _mm512_sub_epi64(a0, c0);
+        __m512i diff1 = _mm512_sub_epi64(a1, c1);
+        unsigned generate = _mm512_cmplt_epu64_mask(a0, c0) | 
+                            (unsigned) _mm512_cmplt_epu64_mask(a1, c1) << 8;
+        unsigned propagate = _mm512_cmpeq_epi64_mask(diff0, zero) | 
+                             (unsigned) _mm512_cmpeq_epi64_mask(diff1, zero) << 8;
+
+        unsigned in = lookahead_carries(generate, propagate, 16, &borrow);
+        _mm512_storeu_si512(dest + i, _mm512_mask_add_epi64(diff0, (__mmask8) in, 
+                                                            diff0, ones));
+        _mm512_storeu_si512(dest + i + 8, _mm512_mask_add_epi64(diff1, 
+                            (__mmask8) (in >> 8), diff1, ones));
+    }
+    for(; i < n; ++i)
+    {
+        dest[i] = subtract_with_carry(&borrow, b1[i], b2[i]);
+    }
+    return borrow;
+}
+
+static const bucket_kernels adx_kernels = 
+{
+    add_n_generic, sub_n_generic, mul_1_adx, addmul_1_adx, sqr_basecase_generic
+};
+
+static const bucket_kernels avx512_kernels = 
+{
+    add_n_avx512, sub_n_avx512, mul_1_adx, addmul_1_adx, sqr_basecase_generic
+};
+
+// Returns non zero if the CPU has the BMI2 mulx and the ADX adcx and adox
+static int cpu_has_adx(void)
+{
+    unsigned eax, ebx, ecx, edx;
+    return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && 
+           (ebx & bit_BMI2) && (ebx & bit_ADX);
+}
+
+// Picks the kernels when the library is loaded
+__attribute__((constructor))
+static void select_kernels(void)
+{
+    BigInt_set_kernels(BIGINT_KERNELS_AUTO);
+    return;
+}
+
+#endif // BIGINT_X64_KERNELS
+
+static const bucket_kernels generic_kernels = 
+{
+    add_n_generic, sub_n_generic, mul_1_generic, addmul_1_generic, 
+    sqr_basecase_generic
+};
+
+static int kernel_set = BIGINT_KERNELS_GENERIC;
+
+// Returns the kernels of set if the CPU supports them, NULL otherwise. Each 
+// set builds on the one before it
+static const bucket_kernels* supported_kernels(int set)
+{
+    if(set == BIGINT_KERNELS_GENERIC)
+    {
+        return &generic_kernels;
+    }
+#ifdef BIGINT_X64_KERNELS
+    if(set < BIGINT_KERNELS_ADX || set > BIGINT_KERNELS_AVX512 || !cpu_has_adx())
+    {
+        return NULL;
+    }
+    __builtin_cpu_init();
+    if(set == BIGINT_KERNELS_AVX512)
+    {
+        return __builtin_cpu_supports("avx512f") ? &avx512_kernels : NULL;
+    }
+    return &adx_kernels;
+#else
+    return NULL;
+#endif
+}
+
+int BigInt_set_kernels(int set)
+{
+    const bucket_kernels* selected = supported_kernels(set);
+    int status = (selected != NULL || set == BIGINT_KERNELS_AUTO) ? 0 : -1;
+    if(selected == NULL)
+    {
+        // Falls back to the best set the CPU supports
+        for(set = BIGINT_KERNELS_AVX512; selected == NULL; --set)
+        {
+            selected = supported_kernels(set);
+        }
+        ++set;
+    }
+    kernels = selected;
+    kernel_set = set;
+    return status;
+}
+
+int BigInt_get_kernels(void)
+{
+    return kernel_set;
+}
+
+static void sqr_basecase(bucket_t* dest, const bucket_t* b, size_t n)
+{
+    kernels->sqr_basecase(dest, b, n);
+    return;
+}
+
+// Upper bound of the scratch buckets used by any multiplication whose longest
+// operand has n buckets. Every recursion level uses at most 4n + 20 buckets of
+// scratch and recurses on operands of at most n / 2 + 2 buckets
+static size_t multiply_scratch_size(size_t n)
+{
+    return 8 * n + 64;
+}
+
+static void mul_dispatch(bucket_t* dest, const bucket_t* b1, size_t n1, 
+                         const bucket_t* b2, size_t n2, bucket_t* scratch);
+
+// The workspace of the context whose product runs on this thread, if any
+static BIGINT_THREAD_LOCAL const product_workspace* workspace = NULL;
+
+typedef struct mul_task
+{
+    bucket_t* dest;
+    const bucket_t* b1;
+    size_t n1;
+    const bucket_t* b2;
+    size_t n2;
+    bucket_t* scratch;
+} mul_task;
+
+static void run_mul_task(void* arg)
+{
+    mul_task* task = (mul_task*) arg;
+    mul_dispatch(task->dest, task->b1, task->n1, task->b2, task->n2, task->scratch);
+    return;
+}
+
+// Computes count independent products whose operands are at most longest 
+// buckets. Products of PARALLEL_THRESHOLD buckets run in parallel when there
+// are worker threads and no context's product is running, each past the first
+// with scratch space of its own, otherwise they run one after another in 
+// scratch
+static void mul_products(mul_task* tasks, size_t count, size_t longest, 
+                         bucket_t* scratch)
+{
+    size_t size = multiply_scratch_size(longest);
+    bucket_t* spare = NULL;
+    if(longest >= PARALLEL_THRESHOLD && workspace == NULL && BigInt_get_threads() > 1)
+    {
+        spare = (bucket_t*) bigint_malloc((count - 1) * size * sizeof(bucket_t));
+    }
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        tasks[i].scratch = (spare != NULL && i > 0) ? spare + (i - 1) * size : scratch;
+    }
+    if(spare != NULL)
+    {
+        parallel_run(run_mul_task, tasks, sizeof(mul_task), count);
+        bigint_free(spare);
+        return;
+    }
+    for(size_t i = 0; i < count; ++i)
+    {
+        run_mul_task(&tasks[i]);
+    }
+    return;
+}
+
+// Multiplication where b1 is at least twice as long as b2. b1 is multiplied in
+// slices of n2 buckets so every sub product is balanced
+static void mul_unbalanced(bucket_t* dest, const bucket_t* b1, size_t n1, 
+                           const bucket_t* b2, size_t n2, bucket_t* scratch)
+{
+    bucket_t* slice = scratch;
+    bucket_t* next = slice + 2 * n2;
+
+    mul_dispatch(dest, b1, n2, b2, n2, next);
+    for(size_t offset = n2; offset < n1; offset += n2)
+    {
+        size_t len = (n1 - offset < n2) ? n1 - offset : n2;
+
+        mul_dispatch(slice, b1 + offset, len, b2, n2, next);
+
+        bucket_t carry = add_n(dest + offset, dest + offset, slice, n2);
+        add_1(dest + offset + n2, slice + n2, len, carry);
+    }
+    return;
+}
+
+// Karatsuba multiplication, n1 >= n2 > ceil(n1 / 2). With b = b_hi * B^h + b_lo
+//
+//   b1 * b2 = z2 * B^2h + (z0 + z2 - (b1_lo - b1_hi)(b2_lo - b2_hi)) * B^h + z0
+//
+// where z0 = b1_lo * b2_lo and z2 = b1_hi * b2_hi
+static void mul_karatsuba(bucket_t* dest, const bucket_t* b1, size_t n1, 
+                          const bucket_t* b2, size_t n2, bucket_t* scratch)
+{
+    size_t h = (n1 + 1) / 2;
+    size_t n = n1 + n2;
+
+    bucket_t* diff1 = scratch;
+    bucket_t* diff2 = diff1 + h;
+    bucket_t* middle = diff2 + h;
+    bucket_t* next = middle + 2 * h + 1;
+
+    // When squaring (b1 - b1)^2 is never negative and every sub product is a
+    // square as well
+    int negative = absolute_difference(diff1, b1, h, b1 + h, n1 - h);
+    if(b1 == b2 && n1 == n2)
+    {
+        diff2 = diff1;
+        negative = 0;
+    }
+    else
+    {
+        negative ^= absolute_difference(diff2, b2, h, b2 + h, n2 - h);
+    }
+
+    mul_task products[] = {
+        { dest, b1, h, b2, h, NULL },
+        { dest + 2 * h, b1 + h, n1 - h, b2 + h, n2 - h, NULL },
+        { middle, diff1, h, diff2, h, NULL }
+    };
+    mul_products(products, 3, h, next);
+
+    // middle = z0 + z2 -/+ |diff1 * diff2|, the two's complement borrow of
+    // z0 - middle is cancelled out once z2 is added
+    if(negative)
+    {
+        middle[2 * h] = add_n(middle, middle, dest, 2 * h);
+    }
+    else
+    {
+        middle[2 * h] = 0 - sub_n(middle, dest, middle, 2 * h);
+    }
+    middle[2 * h] += add_buckets(middle, middle, 2 * h, dest + 2 * h, n - 2 * h);
+
+    add_at(dest, n, h, middle, 2 * h + 1);
+    return;
+}
+
+// Toom-Cook 3 multiplication, n1 >= n2 > 2 * ceil(n1 / 3). Both operands are
+// split into 3 polynomial coefficients and evaluated at 0, 1, -1, 2 and
+// infinity. The 5 point products are interpolated with two's complement
+// arithmetic over 2k + 2 buckets
+static void mul_toom3(bucket_t* dest, const bucket_t* b1, size_t n1, 
+                      const bucket_t* b2, size_t n2, bucket_t* scratch)
+{
+    size_t k = (n1 + 2) / 3;
+    size_t top1 = n1 - 2 * k;
+    size_t top2 = n2 - 2 * k;
+    size_t len = 2 * k + 2;
+    size_t n = n1 + n2;
+
+    const bucket_t* inf = dest + 4 * k;
+    bucket_t* evals = scratch;
+    bucket_t* w1 = evals + 6 * (k + 1);
+    bucket_t* wm1 = w1 + len;
+    bucket_t* w2 = wm1 + len;
+    bucket_t* next = w2 + len;
+
+    // A square only needs the first operand evaluated and its value at -1 is
+    // never negative
+    int negative = 0;
+    int operand_count = (b1 == b2 && n1 == n2) ? 1 : 2;
+    const bucket_t* operands[2] = { b1, b2 };
+    size_t tops[2] = { top1, top2 };
+    for(int i = 0; i < operand_count; ++i)
+    {
+        const bucket_t* low = operands[i];
+        const bucket_t* mid = low + k;
+        const bucket_t* high = mid + k;
+        bucket_t* at1 = evals + 3 * i * (k + 1);
+        bucket_t* atm1 = at1 + k + 1;
+        bucket_t* at2 = atm1 + k + 1;
+
+        // at1 = low + high + mid, atm1 = |low + high - mid|
+        atm1[k] = add_buckets(atm1, low, k, high, tops[i]);
+        at1[k] = atm1[k] + add_n(at1, atm1, mid, k);
+        if(atm1[k] == 0 && compare_buckets(atm1, k, mid, k) < 0)
+        {
+            sub_n(atm1, mid, atm1, k);
+            negative ^= operand_count - 1;
+        }
+        else
+        {
+            atm1[k] -= sub_n(atm1, atm1, mid, k);
+        }
+
+        // at2 = low + 2 mid + 4 high
+        memcpy(at2, low, k * sizeof(bucket_t));
+        at2[k] = addmul_1(at2, mid, k, 2);
+        bucket_t carry = addmul_1(at2, high, tops[i], 4);
+        add_1(at2 + tops[i], at2 + tops[i], k + 1 - tops[i], carry);
+    }
+
+    const bucket_t* evals2 = evals + 3 * (operand_count - 1) * (k + 1);
+
+    mul_task products[] = {
+        { dest, b1, k, b2, k, NULL },
+        { dest + 4 * k, b1 + 2 * k, top1, b2 + 2 * k, top2, NULL },
+        { w1, evals, k + 1, evals2, k + 1, NULL },
+        { wm1, evals + k + 1, k + 1, evals2 + k + 1, k + 1, NULL },
+        { w2, evals + 2 * (k + 1), k + 1, evals2 + 2 * (k + 1), k + 1, NULL }
+    };
+    mul_products(products, 5, k + 1, next);
+    if(negative)
+    {
+        negate_buckets(wm1, len);
+    }
+
+    // w1 = (w1 - wm1) / 2 = c1 + c3
+    sub_n(w1, w1, wm1, len);
+    halve_signed(w1, len);
+
+    // wm1 = wm1 + w1 - w0 - winf = c2
+    add_n(wm1, wm1, w1, len);
+    subtract_buckets(wm1, wm1, len, dest, 2 * k);
+    subtract_buckets(wm1, wm1, len, inf, top1 + top2);
+
+    // w2 = ((w2 - w0 - 4 c2 - 16 winf) / 2 - w1) / 3 = c3
+    subtract_buckets(w2, w2, len, dest, 2 * k);
+    submul_1(w2, wm1, len, 4);
+    bucket_t borrow = submul_1(w2, inf, top1 + top2, 16);
+    sub_1(w2 + top1 + top2, w2 + top1 + top2, len - top1 - top2, borrow);
+    halve_signed(w2, len);
+    sub_n(w2, w2, w1, len);
+    divide_exact_by_3(w2, len);
+
+    // w1 = w1 - w2 = c1
+    sub_n(w1, w1, w2, len);
+
+    memset(dest + 2 * k, 0, 2 * k * sizeof(bucket_t));
+    add_at(dest, n, k, w1, len);
+    add_at(dest, n, 2 * k, wm1, len);
+    add_at(dest, n, 3 * k, w2, len);
+    return;
+}
+
+/*
+ * Number theoretic transform multiplication. The operands are split into
+ * coefficients of 24 or 32 bits and convolved modulo three NTT friendly primes
+ * below 2^30 using Montgomery arithmetic on 32 bit words, so every platform
+ * shares the same transform. The three residues of each coefficient are
+ * recombined with Garner's CRT into a value below 2^86 and carried into the
+ * product.
+ */
+
+#define NTT_PRIMES 3
+#define NTT_MAX_LENGTH ((size_t) 1 << 23)
+
+// All three primes have 3 as a primitive root and support transforms of
+// length 2^23
+static const uint32_t ntt_moduli[NTT_PRIMES] = { 998244353, 167772161, 469762049 };
+
+typedef struct ntt_field
+{
+    uint32_t p;
+    uint32_t neg_inverse; // -p^-1 mod 2^32
+    uint32_t r2;          // 2^64 mod p
+    uint32_t one;         // 2^32 mod p, 1 in montgomery form
+} ntt_field;
+
+static void ntt_field_init(ntt_field* field, uint32_t p)
+{
+    uint32_t inverse = p;
+    for(int i = 0; i < 5; ++i)
+    {
+        inverse *= 2 - p * inverse;
+    }
+    field->p = p;
+    field->neg_inverse = 0 - inverse;
+    field->one = (uint32_t) (((uint64_t) 1 << 32) % p);
+    field->r2 = (uint32_t) ((uint64_t) field->one * field->one % p);
+    return;
+}
+
+// Montgomery reduction of t < p * 2^32, the result is only reduced below 2p.
+// As p < 2^30 values below 4p can be stored in a word, so the butterflies keep
+// their values below 2p and defer the final subtraction
+static uint32_t ntt_reduce_lazy(const ntt_field* field, uint64_t t)
+{
+    uint32_t m = (uint32_t) t * field->neg_inverse;
+    return (uint32_t) ((t + (uint64_t) m * field->p) >> 32);
+}
+
+static uint32_t ntt_reduce(const ntt_field* field, uint64_t t)
+{
+    uint32_t u = ntt_reduce_lazy(field, t);
+    return (u >= field->p) ? u - field->p : u;
+}
+
+static uint32_t ntt_mul(const ntt_field* field, uint32_t a, uint32_t b)
+{
+    return ntt_reduce(field, (uint64_t) a * b);
+}
+
+static uint32_t ntt_add(const ntt_field* field, uint32_t a, uint32_t b)
+{
+    uint32_t sum = a + b;
+    return (sum >= field->p) ? sum - field->p : sum;
+}
+
+static uint32_t ntt_sub(const ntt_field* field, uint32_t a, uint32_t b)
+{
+    return (a >= b) ? a - b : a + field->p - b;
+}
+
+// Converts any 32 bit value into montgomery form
+static uint32_t ntt_to_field(const ntt_field* field, uint32_t a)
+{
+    return ntt_reduce(field, (uint64_t) a * field->r2);
+}
+
+static uint32_t ntt_pow(const ntt_field* field, uint32_t base, uint32_t exp)
+{
+    uint32_t result = field->one;
+    for(; exp > 0; exp >>= 1)
+    {
+        if(exp & 1)
+        {
+            result = ntt_mul(field, result, base);
+        }
+        base = ntt_mul(field, base, base);
+    }
+    return result;
+}
+
+// roots[half + j] = w^j where w is a primitive (2 * half)th root of unity for
+// every power of two half < len. Only the longest row is computed with
+// multiplications, w^j of a shorter row is w^2j of the row above it
+static void ntt_roots(const ntt_field* field, uint32_t* roots, size_t len)
+{
+    const size_t stride = 16;
+    size_t half = len / 2;
+    uint32_t* row = roots + half;
+
+    uint32_t w = ntt_pow(field, ntt_to_field(field, 3), 
+                         (uint32_t) ((field->p - 1) / len));
+    uint32_t w_stride = ntt_pow(field, w, stride);
+
+    // Every product only depends on the root stride places back so the
+    // multiplications can overlap
+    row[0] = field->one;
+    for(size_t j = 1; j < half; ++j)
+    {
+        row[j] = (j < stride) ? ntt_mul(field, row[j - 1], w) 
+                              : ntt_mul(field, row[j - stride], w_stride);
+    }
+
+    for(half /= 2; half > 0; half /= 2)
+    {
+        for(size_t j = 0; j < half; ++j)
+        {
+            roots[half + j] = roots[2 * half + 2 * j];
+        }
+    }
+    return;
+}
+
+// Replaces the roots with their inverses in place. As w^half = -1 the inverse
+// of w^j is -w^(half - j)
+static void ntt_invert_roots(const ntt_field* field, uint32_t* roots, size_t len)
+{
+    for(size_t half = 2; half < len; half *= 2)
+    {
+        uint32_t* row = roots + half;
+        for(size_t j = 1; j < half - j; ++j)
+        {
+            uint32_t swap = row[j];
+            row[j] = field->p - row[half - j];
+            row[half - j] = field->p - swap;
+        }
+        row[half / 2] = field->p - row[half / 2];
+    }
+    return;
+}
+
+// Reduces a value below 4p to below 2p without a branch, the butterflies are
+// too unpredictable for a conditional jump
+static uint32_t ntt_reduce_twice_p(uint32_t a, uint32_t twice_p)
+{
+    return a - (twice_p & (0 - (uint32_t) (a >= twice_p)));
+}
+
+// Transforms at or below this length fit in the L1/L2 cache and are done one
+// stage at a time, larger transforms recurse depth first
+#define NTT_BLOCK_LENGTH 4096
+
+// Halves of at least this length are transformed in parallel, as are the 
+// three residues of a product whose transforms are this long
+#define NTT_PARALLEL_LENGTH ((size_t) 1 << 15)
+
+typedef void (*ntt_transform)(const ntt_field* field, uint32_t* a, size_t len,
+                              const uint32_t* roots);
+
+typedef struct ntt_half
+{
+    ntt_transform transform;
+    const ntt_field* field;
+    uint32_t* a;
+    size_t len;
+    const uint32_t* roots;
+} ntt_half;
+
+static void run_ntt_half(void* arg)
+{
+    ntt_half* half = (ntt_half*) arg;
+    half->transform(half->field, half->a, half->len, half->roots);
+    return;
+}
+
+// Applies transform to both halves of a[0..len), which are independent
+static void ntt_halves(ntt_transform transform, const ntt_field* field, 
+                       uint32_t* a, size_t len, const uint32_t* roots)
+{
+    ntt_half halves[] = {
+        { transform, field, a, len / 2, roots },
+        { transform, field, a + len / 2, len / 2, roots }
+    };
+    if(len / 2 >= NTT_PARALLEL_LENGTH && workspace == NULL)
+    {
+        parallel_run(run_ntt_half, halves, sizeof(ntt_half), 2);
+        return;
+    }
+    run_ntt_half(&halves[0]);
+    run_ntt_half(&halves[1]);
+    return;
+}
+
+// One decimation in frequency stage over a[0..2 * half)
+static void ntt_forward_stage(const ntt_field* field, uint32_t* a, size_t half,
+                              const uint32_t* roots)
+{
+    const uint32_t twice_p = 2 * field->p;
+    uint32_t* hi = a + half;
+    for(size_t j = 0; j < half; ++j)
+    {
+        uint32_t u = a[j];
+        uint32_t v = hi[j];
+        a[j] = ntt_reduce_twice_p(u + v, twice_p);
+        hi[j] = ntt_reduce_lazy(field, (uint64_t) (u - v + twice_p) * roots[half + j]);
+    }
+    return;
+}
+
+// Decimation in frequency transform, leaves the result in bit reversed order.
+// Inputs and outputs are in [0, 2p)
+static void ntt_forward(const ntt_field* field, uint32_t* a, size_t len, 
+                        const uint32_t* roots)
+{
+    if(len > NTT_BLOCK_LENGTH)
+    {
+        ntt_forward_stage(field, a, len / 2, roots);
+        ntt_halves(ntt_forward, field, a, len, roots);
+        return;
+    }
+    for(size_t half = len / 2; half > 0; half /= 2)
+    {
+        for(size_t start = 0; start < len; start += 2 * half)
+        {
+            ntt_forward_stage(field, a + start, half, roots);
+        }
+    }
+    return;
+}
+
+// One decimation in time stage over a[0..2 * half)
+static void ntt_inverse_stage(const ntt_field* field, uint32_t* a, size_t half,
+                              const uint32_t* roots)
+{
+    const uint32_t twice_p = 2 * field->p;
+    uint32_t* hi = a + half;
+    for(size_t j = 0; j < half; ++j)
+    {
+        uint32_t u = a[j];
+        uint32_t v = ntt_reduce_lazy(field, (uint64_t) hi[j] * roots[half + j]);
+        a[j] = ntt_reduce_twice_p(u + v, twice_p);
+        hi[j] = ntt_reduce_twice_p(u - v + twice_p, twice_p);
+    }
+    return;
+}
+
+// Decimation in time inverse transform of bit reversed input in [0, 2p)
+static void ntt_inverse_recursive(const ntt_field* field, uint32_t* a, 
+                                  size_t len, const uint32_t* roots)
+{
+    if(len > NTT_BLOCK_LENGTH)
+    {
+        ntt_halves(ntt_inverse_recursive, field, a, len, roots);
+        ntt_inverse_stage(field, a, len / 2, roots);
+        return;
+    }
+    for(size_t half = 1; half < len; half *= 2)
+    {
+        for(size_t start = 0; start < len; start += 2 * half)
+        {
+            ntt_inverse_stage(field, a + start, half, roots);
+        }
+    }
+    return;
+}
+
+// Inverse transform, the result is scaled by 1 / len, fully reduced and 
+// converted out of montgomery form
+static void ntt_inverse(const ntt_field* field, uint32_t* a, size_t len, 
+                        const uint32_t* roots)
+{
+    ntt_inverse_recursive(field, a, len, roots);
+
+    // len^-1 mod p = p - (p - 1) / len
+    uint32_t scale = field->p - (uint32_t) ((field->p - 1) / len);
+    for(size_t i = 0; i < len; ++i)
+    {
+        a[i] = ntt_mul(field, a[i], scale);
+    }
+    return;
+}
+
+// Reads width <= 32 bits of src starting at bit
+static uint32_t get_chunk(const bucket_t* src, size_t n, size_t bit, 
+                          unsigned width)
+{
+    size_t index = bit / BUCKET_WIDTH;
+    unsigned offset = bit % BUCKET_WIDTH;
+    unsigned read = 0;
+    uint64_t chunk = 0;
+
+    for(; read < width && index < n; ++index)
+    {
+        chunk |= (uint64_t) (src[index] >> offset) << read;
+        read += BUCKET_WIDTH - offset;
+        offset = 0;
+    }
+    return (uint32_t) (chunk & (((uint64_t) 1 << width) - 1));
+}
+
+// ORs the low width <= 32 bits of chunk into dest starting at bit
+static void put_chunk(bucket_t* dest, size_t n, size_t bit, uint64_t chunk, 
+                      unsigned width)
+{
+    size_t index = bit / BUCKET_WIDTH;
+    unsigned offset = bit % BUCKET_WIDTH;
+
+    for(; index < n; ++index)
+    {
+        dest[index] |= (bucket_t) (chunk << offset);
+
+        unsigned written = BUCKET_WIDTH - offset;
+        if(written >= width)
+        {
+            break;
+        }
+        chunk >>= written;
+        width -= written;
+        offset = 0;
+    }
+    return;
+}
+
+// Picks the coefficient width and transform length for an n1 by n2 product.
+// Every convolution coefficient must stay below p1 * p2 * p3 > 2^85. Returns 0
+// if the operands are too long for a single transform
+static int ntt_plan(size_t n1, size_t n2, unsigned* width, size_t* len)
+{
+    static const unsigned widths[] = { 32, 24 };
+
+    for(int i = 0; i < 2; ++i)
+    {
+        size_t chunks = (n1 * BUCKET_WIDTH + widths[i] - 1) / widths[i]
+                      + (n2 * BUCKET_WIDTH + widths[i] - 1) / widths[i];
+        unsigned log_len = 0;
+        for(*len = 1; *len < chunks - 1; *len *= 2)
+        {
+            ++log_len;
+        }
+        if(*len <= NTT_MAX_LENGTH && log_len + 2 * widths[i] <= 85)
+        {
+            *width = widths[i];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Loads the width bit coefficients of src into montgomery form, zero padded
+static void ntt_load(const ntt_field* field, uint32_t* a, size_t len, 
+                     const bucket_t* src, size_t n, unsigned width)
+{
+    size_t chunks = (n * BUCKET_WIDTH + width - 1) / width;
+    for(size_t i = 0; i < chunks; ++i)
+    {
+        a[i] = ntt_to_field(field, get_chunk(src, n, i * width, width));
+    }
+    memset(a + chunks, 0, (len - chunks) * sizeof(uint32_t));
+    return;
+}
+
+// Recombines the residues of every coefficient and carries them into dest
+static void ntt_recombine(bucket_t* dest, size_t n, uint32_t* residues[], 
+                          size_t coefficients, unsigned width)
+{
+    const uint32_t p1 = ntt_moduli[0];
+    const uint32_t p2 = ntt_moduli[1];
+    const uint32_t p3 = ntt_moduli[2];
+    const uint64_t p12 = (uint64_t) p1 * p2;
+
+    ntt_field f2, f3;
+    ntt_field_init(&f2, p2);
+    ntt_field_init(&f3, p3);
+
+    // Montgomery forms of p1^-1 mod p2, (p1 * p2)^-1 mod p3 and p1 mod p3 so
+    // a single reduction yields a plain product
+    uint32_t inverse_p1 = ntt_pow(&f2, ntt_to_field(&f2, p1), p2 - 2);
+    uint32_t inverse_p12 = ntt_pow(&f3, ntt_to_field(&f3, (uint32_t) (p12 % p3)), 
+                                   p3 - 2);
+    uint32_t p1_mod_p3 = ntt_to_field(&f3, p1);
+
+    memset(dest, 0, n * sizeof(bucket_t));
+
+    uint64_t low = 0;
+    uint64_t high = 0;
+    size_t bit = 0;
+    for(size_t i = 0; bit < n * BUCKET_WIDTH; ++i, bit += width)
+    {
+        if(i < coefficients)
+        {
+            uint32_t v1 = residues[0][i];
+            uint32_t v2 = ntt_mul(&f2, ntt_sub(&f2, residues[1][i], v1 % p2), 
+                                  inverse_p1);
+            uint32_t v12 = ntt_add(&f3, v1 % p3, ntt_mul(&f3, p1_mod_p3, v2));
+            uint32_t v3 = ntt_mul(&f3, ntt_sub(&f3, residues[2][i], v12), 
+                                  inverse_p12);
+
+            // low:high += v1 + p1 * v2 + p1 * p2 * v3
+            uint64_t base = v1 + (uint64_t) p1 * v2;
+            uint64_t mid = (uint64_t) v3 * (uint32_t) p12;
+            uint64_t top = (uint64_t) v3 * (uint32_t) (p12 >> 32);
+
+            low += base;
+            high += (low < base);
+            low += mid;
+            high += (low < mid);
+            low += top << 32;
+            high += (low < (top << 32)) + (top >> 32);
+        }
+        else if(low == 0 && high == 0)
+        {
+            break;
+        }
+
+        put_chunk(dest, n, bit, low & (((uint64_t) 1 << width) - 1), width);
+        low = (low >> width) | (high << (64 - width));
+        high >>= width;
+    }
+    return;
+}
+
+typedef struct ntt_residue
+{
+    uint32_t p;
+    uint32_t* residue;
+    uint32_t* work;
+    uint32_t* roots;
+    const bucket_t* b1;
+    size_t n1;
+    const bucket_t* b2;
+    size_t n2;
+    size_t len;
+    unsigned width;
+} ntt_residue;
+
+// Convolves the operands modulo task->p into task->residue
+static void run_ntt_residue(void* arg)
+{
+    ntt_residue* task = (ntt_residue*) arg;
+    size_t len = task->len;
+    uint32_t* residue = task->residue;
+    uint32_t* work = task->work;
+
+    ntt_field field;
+    ntt_field_init(&field, task->p);
+
+    ntt_roots(&field, task->roots, len);
+
+    // A square only needs one forward transform
+    ntt_load(&field, residue, len, task->b1, task->n1, task->width);
+    ntt_forward(&field, residue, len, task->roots);
+    if(task->b1 == task->b2 && task->n1 == task->n2)
+    {
+        work = residue;
+    }
+    else
+    {
+        ntt_load(&field, work, len, task->b2, task->n2, task->width);
+        ntt_forward(&field, work, len, task->roots);
+    }
+
+    for(size_t j = 0; j < len; ++j)
+    {
+        residue[j] = ntt_reduce_lazy(&field, (uint64_t) residue[j] * work[j]);
+    }
+
+    ntt_invert_roots(&field, task->roots, len);
+    ntt_inverse(&field, residue, len, task->roots);
+    return;
+}
+
+// NTT multiplication, returns 0 without touching dest if the operands are too
+// long for a single transform or memory couldn't be allocated. With worker 
+// threads long enough products give every prime its own work and roots 
+// buffers and compute the residues in parallel
+static int mul_ntt(bucket_t* dest, const bucket_t* b1, size_t n1, 
+                   const bucket_t* b2, size_t n2)
+{
+    unsigned width;
+    size_t len;
+    if(!ntt_plan(n1, n2, &width, &len))
+    {
+        return 0;
+    }
+
+    int reuse = workspace != NULL && workspace->ntt_length == len;
+    int parallel = workspace == NULL && len >= NTT_PARALLEL_LENGTH && 
+                   BigInt_get_threads() > 1;
+    size_t buffers = parallel ? NTT_PRIMES : 1;
+
+    uint32_t* memory = reuse ? workspace->ntt_memory : 
+                       (uint32_t*) bigint_malloc((NTT_PRIMES + 2 * buffers) * 
+                                                 len * sizeof(uint32_t));
+    if(memory == NULL)
+    {
+        return 0;
+    }
+
+    ntt_residue tasks[NTT_PRIMES];
+    uint32_t* residues[NTT_PRIMES];
+    for(size_t i = 0; i < NTT_PRIMES; ++i)
+    {
+        uint32_t* buffer = memory + (NTT_PRIMES + 2 * (i % buffers)) * len;
+        ntt_residue task = { ntt_moduli[i], memory + i * len, buffer, buffer + len,
+                             b1, n1, b2, n2, len, width };
+        tasks[i] = task;
+        residues[i] = task.residue;
+    }
+
+    if(parallel)
+    {
+        parallel_run(run_ntt_residue, tasks, sizeof(ntt_residue), NTT_PRIMES);
+    }
+    else
+    {
+        for(size_t i = 0; i < NTT_PRIMES; ++i)
+        {
+            run_ntt_residue(&tasks[i]);
+        }
+    }
+
+    ntt_recombine(dest, n1 + n2, residues, len, width);
+
+    if(!reuse)
+    {
+        bigint_free(memory);
+    }
+    return 1;
+}
+
+// Selects the squaring algorithm by length. Every tier recognizes a square by
+// its operands being the same array and only evaluates or transforms it once
+static void sqr_dispatch(bucket_t* dest, const bucket_t* b, size_t n, 
+                         bucket_t* scratch)
+{
+    if(n < KARATSUBA_SQR_THRESHOLD)
+    {
+        sqr_basecase(dest, b, n);
+    }
+    else if(n >= NTT_THRESHOLD && mul_ntt(dest, b, n, b, n))
+    {
+        return;
+    }
+    else if(n < TOOM3_THRESHOLD)
+    {
+        mul_karatsuba(dest, b, n, b, n, scratch);
+    }
+    else
+    {
+        mul_toom3(dest, b, n, b, n, scratch);
+    }
+    return;
+}
+
+// Selects the multiplication algorithm by the length of the shorter operand
+static void mul_dispatch(bucket_t* dest, const bucket_t* b1, size_t n1, 
+                         const bucket_t* b2, size_t n2, bucket_t* scratch)
+{
+    if(b1 == b2 && n1 == n2)
+    {
+        sqr_dispatch(dest, b1, n1, scratch);
+        return;
+    }
+    if(n1 < n2)
+    {
+        const bucket_t* swap = b1;
+        b1 = b2;
+        b2 = swap;
+        n1 ^= n2;
+        n2 ^= n1;
+        n1 ^= n2;
+    }
+
+    if(n2 < KARATSUBA_THRESHOLD)
+    {
+        mul_basecase(dest, b1, n1, b2, n2);
+    }
+    else if(n2 >= NTT_THRESHOLD && mul_ntt(dest, b1, n1, b2, n2))
+    {
+        return;
+    }
+    else if(n2 <= (n1 + 1) / 2)
+    {
+        mul_unbalanced(dest, b1, n1, b2, n2, scratch);
+    }
+    else if(n2 < TOOM3_THRESHOLD || n2 <= 2 * ((n1 + 2) / 3))
+    {
+        mul_karatsuba(dest, b1, n1, b2, n2, scratch);
+    }
+    else
+    {
+        mul_toom3(dest, b1, n1, b2, n2, scratch);
+    }
+    return;
+}
+
+// dest[0..n1 + n2) = b1[0..n1) * b2[0..n2), dest must not overlap the sources.
+// The scratch space for every level of recursion is allocated once up front.
+// Passing the same array as both operands takes the squaring path
+static void multiply_buckets(bucket_t* dest, const bucket_t* b1, size_t n1, 
+                             const bucket_t* b2, size_t n2)
+{
+    size_t longer = (n1 > n2) ? n1 : n2;
+    size_t shorter = (n1 > n2) ? n2 : n1;
+
+    bucket_t* scratch = NULL;
+    if(shorter >= KARATSUBA_THRESHOLD)
+    {
+        scratch = (bucket_t*) bigint_malloc(multiply_scratch_size(longer) * sizeof(bucket_t));
+    }
+
+    if(scratch)
+    {
+        mul_dispatch(dest, b1, n1, b2, n2, scratch);
+        bigint_free(scratch);
+    }
+    else if(b1 == b2 && n1 == n2)
+    {
+        sqr_basecase(dest, b1, n1);
+    }
+    else if(n1 < n2)
+    {
+        mul_basecase(dest, b2, n2, b1, n1);
+    }
+    else
+    {
+        mul_basecase(dest, b1, n1, b2, n2);
+    }
+    return;
+}
+
+/*
+ * Division. The divisor is normalized so its top bit is set, which bounds the
+ * error of each estimated quotient bucket by two (Knuth vol 2, 4.3.1 D)
+ */
+
+// quotient[0..n) = src[0..n) / divisor, returns the remainder. quotient may be
+// src. This is the hot loop of radix conversion
+static bucket_t divrem_1(bucket_t* quotient, const bucket_t* src, size_t n,
+                         bucket_t divisor)
+{
+    bucket_t remainder = 0;
+    for(size_t i = n; i-- > 0;)
+    {
+        quotient[i] = divide_with_remainder(&remainder, remainder, src[i], 
+                                            divisor);
+    }
+    return remainder;
+}
+
+// Estimates the quotient bucket of top[2..0] / (d1:d0) where d1 has its top
+// bit set and top[2..1] <= (d1:d0). The estimate is never too small and at
+// most one too large
+static bucket_t estimate_quotient(const bucket_t* top, bucket_t d1, bucket_t d0)
+{
+    bucket_t qhat;
+    bucket_t rhat;
+    if(top[2] >= d1)
+    {
+        // The quotient of the top buckets doesn't fit, clamp it to B - 1
+        qhat = BUCKET_MAX_SIZE;
+        rhat = top[1] + d1;
+        if(rhat < d1)
+        {
+            return qhat;
+        }
+    }
+    else
+    {
+        qhat = divide_with_remainder(&rhat, top[2], top[1], d1);
+    }
+
+    // While qhat * d0 > rhat:top[0] the estimate is too large
+    for(;;)
+    {
+        bucket_t high = 0;
+        bucket_t low = mul_add_with_carry(&high, qhat, d0, 0);
+        if(high < rhat || (high == rhat && low <= top[0]))
+        {
+            return qhat;
+        }
+        --qhat;
+        rhat += d1;
+        if(rhat < d1)
+        {
+            return qhat;
+        }
+    }
+}
+
+// Schoolbook long division of a normalized divisor. On entry num[0..nn] holds
+// the dividend with a leading extra bucket, on exit num[0..dn) holds the
+// remainder and quotient[0..nn - dn] the quotient
+static void divrem_basecase(bucket_t* quotient, bucket_t* num, size_t nn,
+                            const bucket_t* d, size_t dn)
+{
+    bucket_t d1 = d[dn - 1];
+    bucket_t d0 = d[dn - 2];
+
+    for(size_t j = nn - dn + 1; j-- > 0;)
+    {
+        bucket_t* window = num + j;
+        bucket_t qhat = estimate_quotient(window + dn - 2, d1, d0);
+
+        bucket_t borrow = submul_1(window, d, dn, qhat);
+        bucket_t top = window[dn];
+        window[dn] = top - borrow;
+        if(top < borrow)
+        {
+            // The estimate was one too large, add the divisor back
+            --qhat;
+            window[dn] += add_n(window, window, d, dn);
+        }
+        quotient[j] = qhat;
+    }
+    return;
+}
+
+// x[0..m] = floor(B^2m / d[0..m)) for a normalized divisor. The reciprocal of
+// the top half of d is lifted to full precision by one Newton step, then made
+// exact. Returns 0 if scratch space could not be allocated
+static int reciprocal_buckets(bucket_t* x, const bucket_t* d, size_t m)
+{
+    if(m < NEWTON_DIV_THRESHOLD)
+    {
+        bucket_t* power = allocate_buckets(3 * m + 4);
+        if(power == NULL)
+        {
+            return 0;
+        }
+        bucket_t* q = power + 2 * m + 2;
+
+        power[2 * m] = 1;
+        divrem_basecase(q, power, 2 * m + 1, d, m);
+        memcpy(x, q, (m + 1) * sizeof(bucket_t));
+
+        bigint_free(power);
+        return 1;
+    }
+
+    // One guard bucket above half precision keeps the Newton step within a
+    // couple of units of the exact reciprocal
+    size_t h = m / 2 + 1;
+    size_t l = m - h;
+    size_t en = m + h + 1;
+
+    bucket_t* xh = allocate_buckets((h + 1) + 2 * en + (h + 1 + en) + 
+                                    3 * (2 * m + 2));
+    if(xh == NULL)
+    {
+        return 0;
+    }
+    bucket_t* t = xh + h + 1;
+    bucket_t* e = t + en;
+    bucket_t* p = e + en;
+    bucket_t* product = p + h + 1 + en;
+    bucket_t* sum = product + 2 * m + 2;
+    bucket_t* power = sum + 2 * m + 2;
+
+    if(!reciprocal_buckets(xh, d + l, h))
+    {
+        bigint_free(xh);
+        return 0;
+    }
+
+    // e = |B^(m + h) - d * xh|, the error of xh scaled to the length of d
+    multiply_buckets(t, d, m, xh, h + 1);
+    e[en - 1] = 1;
+    int negative = absolute_difference(e, e, en, t, en);
+
+    // x = xh * B^l + xh * e / B^2h. The low h - 1 buckets of e are below the 
+    // precision of the correction and are dropped
+    size_t elen = en - (h - 1);
+    const bucket_t* error = e + h - 1;
+    while(elen > 0 && error[elen - 1] == 0)
+    {
+        --elen;
+    }
+
+    memset(x, 0, l * sizeof(bucket_t));
+    memcpy(x + l, xh, (h + 1) * sizeof(bucket_t));
+
+    // d * x is found from d * xh * B^l and d times the correction
+    memcpy(product + l, t, en * sizeof(bucket_t));
+
+    if(elen > 0)
+    {
+        multiply_buckets(p, xh, h + 1, error, elen);
+
+        const bucket_t* correction = p + h + 1;
+        size_t cn = elen;
+        while(cn > 0 && correction[cn - 1] == 0)
+        {
+            --cn;
+        }
+        if(cn > 0)
+        {
+            multiply_buckets(sum, d, m, correction, cn);
+            if(negative)
+            {
+                subtract_buckets(x, x, m + 1, correction, cn);
+                subtract_buckets(product, product, 2 * m + 1, sum, m + cn);
+            }
+            else
+            {
+                add_buckets(x, x, m + 1, correction, cn);
+                add_buckets(product, product, 2 * m + 1, sum, m + cn);
+            }
+        }
+    }
+
+    // Steps x to the largest value with d * x <= B^2m
+    power[2 * m] = 1;
+    while(compare_buckets(product, 2 * m + 1, power, 2 * m + 1) > 0)
+    {
+        sub_1(x, x, m + 1, 1);
+        subtract_buckets(product, product, 2 * m + 1, d, m);
+    }
+    for(;;)
+    {
+        add_buckets(sum, product, 2 * m + 1, d, m);
+        if(compare_buckets(sum, 2 * m + 1, power, 2 * m + 1) > 0)
+        {
+            break;
+        }
+        memcpy(product, sum, (2 * m + 1) * sizeof(bucket_t));
+        add_1(x, x, m + 1, 1);
+    }
+
+    bigint_free(xh);
+    return 1;
+}
+
+// Long division by a normalized divisor using its reciprocal. Same contract as
+// divrem_basecase, but the quotient is produced dn buckets at a time by two
+// multiplications, so each block costs a constant number of multiplies
+static int divrem_newton(bucket_t* quotient, bucket_t* num, size_t nn,
+                         const bucket_t* d, size_t dn)
+{
+    bucket_t* x = (bucket_t*) bigint_malloc(((dn + 1) + (2 * dn + 2) + 2 * dn) * 
+                                     sizeof(bucket_t));
+    if(x == NULL || !reciprocal_buckets(x, d, dn))
+    {
+        bigint_free(x);
+        return 0;
+    }
+    bucket_t* p = x + dn + 1;
+    bucket_t* t = p + 2 * dn + 2;
+
+    for(size_t j = nn + 1 - dn; j > 0;)
+    {
+        size_t len = (j < dn) ? j : dn;
+        j -= len;
+
+        // window[0..dn + len) is below d * B^len, its quotient is len buckets
+        bucket_t* window = num + j;
+        bucket_t* q = quotient + j;
+
+        // Multiplying the top of the window by the reciprocal never 
+        // overestimates the quotient and is at most 3 too small
+        multiply_buckets(p, window + dn - 1, len + 1, x, dn + 1);
+        memcpy(q, p + dn + 1, len * sizeof(bucket_t));
+
+        multiply_buckets(t, q, len, d, dn);
+        sub_n(window, window, t, dn + len);
+        while(window[dn] != 0 || compare_buckets(window, dn, d, dn) >= 0)
+        {
+            window[dn] -= sub_n(window, window, d, dn);
+            add_1(q, q, len, 1);
+        }
+    }
+    bigint_free(x);
+    return 1;
+}
+
+static int divide_buckets(bucket_t* quotient, bucket_t* remainder,
+                          const bucket_t* n, size_t nn, 
+                          const bucket_t* d, size_t dn);
+
+// Division where the quotient is much shorter than the divisor. Only the top
+// qn + 1 buckets of the divisor decide the quotient, it is computed from them
+// and the few units it is too large are corrected against the full divisor
+static int divide_truncated(bucket_t* quotient, bucket_t* remainder,
+                            const bucket_t* n, size_t nn, 
+                            const bucket_t* d, size_t dn)
+{
+    size_t qn = nn - dn + 1;
+    size_t skip = dn - qn - 1;
+
+    bucket_t* product = (bucket_t*) bigint_malloc((nn + 1 + qn + 1) * sizeof(bucket_t));
+    if(product == NULL)
+    {
+        return 0;
+    }
+    if(!divide_buckets(quotient, product + nn + 1, n + skip, nn - skip, 
+                       d + skip, dn - skip))
+    {
+        bigint_free(product);
+        return 0;
+    }
+
+    multiply_buckets(product, d, dn, quotient, qn);
+    while(product[nn] != 0 || compare_buckets(product, nn, n, nn) > 0)
+    {
+        sub_1(quotient, quotient, qn, 1);
+        subtract_buckets(product, product, nn + 1, d, dn);
+    }
+
+    // The remainder is below d, the buckets above dn cancel
+    sub_n(remainder, n, product, dn);
+
+    bigint_free(product);
+    return 1;
+}
+
+// quotient[0..nn - dn] = n[0..nn) / d[0..dn), remainder[0..dn) = n % d. nn >=
+// dn and the leading bucket of d is non zero. Long quotients of long divisors
+// use the Newton reciprocal. Returns 0 if scratch space could not be allocated
+static int divide_buckets(bucket_t* quotient, bucket_t* remainder,
+                          const bucket_t* n, size_t nn, 
+                          const bucket_t* d, size_t dn)
+{
+    if(dn == 1)
+    {
+        remainder[0] = divrem_1(quotient, n, nn, d[0]);
+        return 1;
+    }
+
+    size_t qn = nn - dn + 1;
+    int newton = qn >= NEWTON_DIV_THRESHOLD && 2 * dn >= NEWTON_DIV_THRESHOLD;
+    if(newton && qn + 1 < dn)
+    {
+        return divide_truncated(quotient, remainder, n, nn, d, dn);
+    }
+
+    bucket_t* num = (bucket_t*) bigint_malloc((nn + 1 + dn) * sizeof(bucket_t));
+    if(num == NULL)
+    {
+        return 0;
+    }
+    bucket_t* divisor = num + nn + 1;
+
+    // Shifts both operands so the leading bit of the divisor is set, this does
+    // not change the quotient and scales the remainder by the same amount
+    unsigned shift = count_leading_zeros(d[dn - 1]);
+    if(shift > 0)
+    {
+        lshift(divisor, d, dn, shift);
+        num[nn] = lshift(num, n, nn, shift);
+    }
+    else
+    {
+        memcpy(divisor, d, dn * sizeof(bucket_t));
+        memcpy(num, n, nn * sizeof(bucket_t));
+        num[nn] = 0;
+    }
+
+    int success = 1;
+    if(newton)
+    {
+        success = divrem_newton(quotient, num, nn, divisor, dn);
+    }
+    else
+    {
+        divrem_basecase(quotient, num, nn, divisor, dn);
+    }
+
+    if(shift > 0)
+    {
+        rshift(remainder, num, dn, shift);
+    }
+    else
+    {
+        memcpy(remainder, num, dn * sizeof(bucket_t));
+    }
+    bigint_free(num);
+    return success;
+}
+
+// dest = sign1 * |b1| + sign2 * |b2|, dest may be either operand. The
+// magnitudes are added when the signs agree, otherwise the smaller is 
+// subtracted from the larger, whose sign the result takes. Returns NULL if 
+// dest can't grow to hold the result
+static BigInt* evaluate(BigInt* dest, BigInt* b1, int8_t sign1, 
+                        BigInt* b2, int8_t sign2)
+{
+    size_t b1_buckets = leading_bucket(b1);
+    size_t b2_buckets = leading_bucket(b2);
+
+    // A sum only needs the longer operand first, a difference the larger one
+    int same_sign = (sign1 < 0) == (sign2 < 0);
+    if(same_sign ? b1_buckets < b2_buckets 
+                 : compare_buckets(b1->value, b1_buckets, b2->value, b2_buckets) < 0)
+    {
+        BigInt* swap = b1;
+        b1 = b2;
+        b2 = swap;
+
+        size_t swap_buckets = b1_buckets;
+        b1_buckets = b2_buckets;
+        b2_buckets = swap_buckets;
+
+        int8_t swap_sign = sign1;
+        sign1 = sign2;
+        sign2 = swap_sign;
+    }
+
+    // Every bucket of dest past the larger operand is already zero
+    if(!grow_BigInt(dest, b1_buckets + same_sign))
+    {
+        return NULL;
+    }
+    if(same_sign)
+    {
+        dest->value[b1_buckets] = add_buckets(dest->value, b1->value, b1_buckets,
+                                              b2->value, b2_buckets);
+    }
+    else
+    {
+        subtract_buckets(dest->value, b1->value, b1_buckets, 
+                         b2->value, b2_buckets);
+    }
+    trim_BigInt(dest, b1_buckets + same_sign);
+
+    dest->sign = equals_zero(dest) ? 1 : ((sign1 < 0) ? -1 : 1);
+    return dest;
+}
+
+BigInt* add(BigInt* b1, BigInt* b2)
+{
+    if(b1 == NULL || b2 == NULL)
+    {
+        return NULL;
+    }
+
+    size_t b1_buckets = leading_bucket(b1);
+    size_t b2_buckets = leading_bucket(b2);
+    BigInt* result = reserve_BigInt(((b1_buckets > b2_buckets) ? b1_buckets 
+                                                               : b2_buckets) + 1);
+    if(result && result->value)
+    {
+        evaluate(result, b1, b1->sign, b2, b2->sign);
+    }
+    return result;
+}
+
+BigInt* add_into(BigInt* src, BigInt* dest)
+{
+    if(src == NULL || dest == NULL)
+    {
+        return NULL;
+    }
+    return evaluate(dest, dest, dest->sign, src, src->sign);
+}
+
+BigInt* subtract(BigInt* b1, BigInt* b2)
+{
+    if(b1 == NULL || b2 == NULL)
+    {
+        return NULL;
+    }
+
+    size_t b1_buckets = leading_bucket(b1);
+    size_t b2_buckets = leading_bucket(b2);
+    BigInt* result = reserve_BigInt(((b1_buckets > b2_buckets) ? b1_buckets 
+                                                               : b2_buckets) + 1);
+    if(result && result->value)
+    {
+        evaluate(result, b1, b1->sign, b2, -b2->sign);
+    }
+    return result;
+}
+
+BigInt* subtract_from(BigInt* src, BigInt* dest)
+{
+    if(src == NULL || dest == NULL)
+    {
+        return NULL;
+    }
+    return evaluate(dest, dest, dest->sign, src, -src->sign);
+}
+
+BigInt* multiply(BigInt* b1, BigInt* b2)
+{
+    if(b1 == NULL || b2 == NULL)
+    {
+        return NULL;
+    }
+
+    size_t b1_buckets = leading_bucket(b1);
+    size_t b2_buckets = leading_bucket(b2);
+
+    BigInt* result = reserve_BigInt(b1_buckets + b2_buckets);
+    if(result)
+    {
+        multiply_buckets(result->value, b1->value, b1_buckets, 
+                         b2->value, b2_buckets);
+        trim_BigInt(result, b1_buckets + b2_buckets);
+
+        result->sign = equals_zero(result) ? 1 : b1->sign * b2->sign;
+    }
+    return result;
+}
+
+// Makes the nbuckets of product the value of dest. A product in the stack 
+// buffer small is copied into dest's own buckets, any other takes their 
+// place. Either way a view or mapping is left alone. Returns 0 if dest can't
+// grow to hold it
+static int store_product(BigInt* dest, bucket_t* product, size_t nbuckets, 
+                         const bucket_t* small)
+{
+    int owned = dest->storage == BUCKETS_OWNED || dest->storage == BUCKETS_INLINE;
+    if(product != small)
+    {
+        replace_buckets(dest, product, nbuckets);
+    }
+    else if(owned ? grow_BigInt(dest, nbuckets) : resize_buckets(dest, nbuckets))
+    {
+        // The product is at least as long as dest's old value
+        memcpy(dest->value, small, nbuckets * sizeof(bucket_t));
+    }
+    else
+    {
+        return 0;
+    }
+    trim_BigInt(dest, nbuckets);
+    return 1;
+}
+
+BigInt* multiply_into(BigInt* src, BigInt* dest)
+{
+    if(src == NULL || dest == NULL)
+    {
+        return NULL;
+    }
+
+    size_t src_buckets = leading_bucket(src);
+    size_t dest_buckets = leading_bucket(dest);
+    size_t nbuckets = src_buckets + dest_buckets;
+
+    // The product can't be accumulated in place. A small one is built on the
+    // stack and copied back, a large one replaces dest's buckets
+    bucket_t small[INLINE_BUCKETS];
+    bucket_t* product = (nbuckets <= INLINE_BUCKETS) ? small 
+                                                     : allocate_buckets(nbuckets);
+    if(product == NULL)
+    {
+        return NULL;
+    }
+    multiply_buckets(product, dest->value, dest_buckets, 
+                     src->value, src_buckets);
+
+    if(!store_product(dest, product, nbuckets, small))
+    {
+        return NULL;
+    }
+
+    dest->sign = equals_zero(dest) ? 1 : dest->sign * src->sign;
+    return dest;
+}
+
+BigInt* square(BigInt* num)
+{
+    if(num == NULL)
+    {
+        return NULL;
+    }
+
+    size_t nbuckets = leading_bucket(num);
+
+    BigInt* result = reserve_BigInt(2 * nbuckets);
+    if(result)
+    {
+        multiply_buckets(result->value, num->value, nbuckets, 
+                         num->value, nbuckets);
+        trim_BigInt(result, 2 * nbuckets);
+    }
+    return result;
+}
+
+BigInt* square_into(BigInt* num)
+{
+    if(num == NULL)
+    {
+        return NULL;
+    }
+
+    size_t nbuckets = leading_bucket(num);
+    size_t size = 2 * nbuckets;
+
+    bucket_t small[INLINE_BUCKETS];
+    bucket_t* product = (size <= INLINE_BUCKETS) ? small : allocate_buckets(size);
+    if(product == NULL)
+    {
+        return NULL;
+    }
+    multiply_buckets(product, num->value, nbuckets, num->value, nbuckets);
+
+    if(!store_product(num, product, size, small))
+    {
+        return NULL;
+    }
+    num->sign = 1;
+    return num;
+}
+
+/*
+ * Batches of small BigInts are bound by fetching each item's scattered 
+ * BigInts and buckets, not by the arithmetic. The loops prefetch the BigInts
+ * of the item BATCH_PREFETCH ahead and the buckets of the item half as far
+ * ahead, whose BigInts have arrived by then, so the misses of many items are
+ * in flight at once. A batch on one thread grows and computes each item in a
+ * single pass. A batch split across threads grows every dest in the calling 
+ * thread first, so the workers allocate nothing that outlives an item
+ */
+#define BATCH_PREFETCH 16
+
+// Batches of at least this many items are split across the worker threads
+#define BATCH_PARALLEL_COUNT 1024
+
+#if defined( __GNUC__ )
+    #define PREFETCH(address) __builtin_prefetch(address)
+#else
+    #define PREFETCH(address) ((void) (address))
+#endif
+
+enum batch_op { BATCH_ADD, BATCH_SUBTRACT, BATCH_MULTIPLY };
+
+typedef struct batch_task
+{
+    enum batch_op op;
+    BigInt* const* dest;
+    BigInt* const* b1;
+    BigInt* const* b2;
+    size_t start;
+    size_t end;
+} batch_task;
+
+static void prefetch_item(const batch_task* task, size_t i)
+{
+    size_t far = i + BATCH_PREFETCH;
+    size_t near = i + BATCH_PREFETCH / 2;
+    if(far < task->end)
+    {
+        PREFETCH(task->dest[far]);
+        PREFETCH(task->b1[far]);
+        PREFETCH(task->b2[far]);
+    }
+    if(near < task->end)
+    {
+        PREFETCH(task->dest[near]->value);
+        PREFETCH(task->b1[near]->value);
+        PREFETCH(task->b2[near]->value);
+    }
+    return;
+}
+
+// Grows dest[i] to hold the result and zeroes its buckets past the ones the 
+// result writes. A dest that is an operand is never longer than the result.
+// A product into one of its operands is computed here by multiply_into or 
+// square_into. Returns 0 if memory couldn't be allocated
+static int prepare_item(const batch_task* task, size_t i)
+{
+    BigInt* dest = task->dest[i];
+    BigInt* b1 = task->b1[i];
+    BigInt* b2 = task->b2[i];
+    size_t b1_buckets = leading_bucket(b1);
+    size_t b2_buckets = leading_bucket(b2);
+
+    size_t needed = b1_buckets + b2_buckets;
+    size_t written = needed;
+    if(task->op != BATCH_MULTIPLY)
+    {
+        written = (b1_buckets > b2_buckets) ? b1_buckets : b2_buckets;
+        needed = written + 1;
+    }
+    else if(dest == b1 || dest == b2)
+    {
+        if(dest == b1 && dest == b2)
+        {
+            return square_into(dest) != NULL;
+        }
+        return multiply_into((dest == b1) ? b2 : b1, dest) != NULL;
+    }
+
+    if(!grow_BigInt(dest, needed))
+    {
+        return 0;
+    }
+    if(dest->length > written)
+    {
+        memset(dest->value + written, 0, (dest->length - written) * sizeof(bucket_t));
+    }
+    return 1;
+}
+
+// Computes item i of a batch prepared by prepare_item, which never allocates
+static void compute_item(const batch_task* task, size_t i)
+{
+    BigInt* dest = task->dest[i];
+    BigInt* b1 = task->b1[i];
+    BigInt* b2 = task->b2[i];
+    if(task->op == BATCH_ADD)
+    {
+        evaluate(dest, b1, b1->sign, b2, b2->sign);
+    }
+    else if(task->op == BATCH_SUBTRACT)
+    {
+        evaluate(dest, b1, b1->sign, b2, -b2->sign);
+    }
+    else if(dest != b1 && dest != b2)
+    {
+        size_t b1_buckets = leading_bucket(b1);
+        size_t b2_buckets = leading_bucket(b2);
+        multiply_buckets(dest->value, b1->value, b1_buckets, 
+                         b2->value, b2_buckets);
+        trim_BigInt(dest, b1_buckets + b2_buckets);
+        dest->sign = equals_zero(dest) ? 1 : b1->sign * b2->sign;
+    }
+    return;
+}
+
+// Prepares and computes item i on its own. A sum or difference is grown by 
+// evaluate, so only the stale buckets of a separate dest are cleared first
+static int evaluate_item(const batch_task* task, size_t i)
+{
+    if(task->op == BATCH_MULTIPLY)
+    {
+        if(!prepare_item(task, i))
+        {
+            return 0;
+        }
+        compute_item(task, i);
+        return 1;
+    }
+
+    BigInt* dest = task->dest[i];
+    BigInt* b1 = task->b1[i];
+    BigInt* b2 = task->b2[i];
+    size_t longer = (b1->length > b2->length) ? b1->length : b2->length;
+    if(dest->length > longer)
+    {
+        memset(dest->value + longer, 0, (dest->length - longer) * sizeof(bucket_t));
+    }
+    int8_t sign2 = (task->op == BATCH_ADD) ? b2->sign : -b2->sign;
+    return evaluate(dest, b1, b1->sign, b2, sign2) != NULL;
+}
+
+static void run_batch_task(void* arg)
+{
+    batch_task* task = (batch_task*) arg;
+    for(size_t i = task->start; i < task->end; ++i)
+    {
+        prefetch_item(task, i);
+        compute_item(task, i);
+    }
+    return;
+}
+
+static int evaluate_batch(enum batch_op op, BigInt* const* dest, 
+                          BigInt* const* b1, BigInt* const* b2, size_t count)
+{
+    if(dest == NULL || b1 == NULL || b2 == NULL)
+    {
+        return -1;
+    }
+    for(size_t i = 0; i < count; ++i)
+    {
+        if(dest[i] == NULL || b1[i] == NULL || b2[i] == NULL)
+        {
+            return -1;
+        }
+    }
+
+    batch_task batch = { op, dest, b1, b2, 0, count };
+    size_t slices = BigInt_get_threads();
+    if(count < BATCH_PARALLEL_COUNT || slices == 1)
+    {
+        for(size_t i = 0; i < count; ++i)
+        {
+            prefetch_item(&batch, i);
+            if(!evaluate_item(&batch, i))
+            {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        prefetch_item(&batch, i);
+        if(!prepare_item(&batch, i))
+        {
+            return -1;
+        }
+    }
+
+    slices = (slices < PARALLEL_MAX_TASKS) ? slices : PARALLEL_MAX_TASKS;
+    batch_task tasks[PARALLEL_MAX_TASKS];
+    for(size_t i = 0; i < slices; ++i)
+    {
+        tasks[i] = batch;
+        tasks[i].start = count * i / slices;
+        tasks[i].end = count * (i + 1) / slices;
+    }
+    parallel_run(run_batch_task, tasks, sizeof(batch_task), slices);
+    return 0;
+}
+
+int add_batch(BigInt* const* dest, BigInt* const* b1, BigInt* const* b2, 
+              size_t count)
+{
+    return evaluate_batch(BATCH_ADD, dest, b1, b2, count);
+}
+
+int subtract_batch(BigInt* const* dest, BigInt* const* b1, BigInt* const* b2, 
+                   size_t count)
+{
+    return evaluate_batch(BATCH_SUBTRACT, dest, b1, b2, count);
+}
+
+int multiply_batch(BigInt* const* dest, BigInt* const* b1, BigInt* const* b2, 
+                   size_t count)
+{
+    return evaluate_batch(BATCH_MULTIPLY, dest, b1, b2, count);
+}
+
+int divmod(BigInt* n, BigInt* d, BigInt** q, BigInt** r)
+{
+    if(n == NULL || d == NULL || equals_zero(d))
+    {
+        return -1;
+    }
+
+    size_t n_buckets = leading_bucket(n);
+    size_t d_buckets = leading_bucket(d);
+
+    BigInt* quotient = NULL;
+    BigInt* remainder = NULL;
+    if(n_buckets < d_buckets)
+    {
+        // |n| < |d|, the quotient is 0 and the remainder is n
+        quotient = empty_BigInt();
+        remainder = reserve_BigInt(n_buckets);
+        if(remainder)
+        {
+            memcpy(remainder->value, n->value, n_buckets * sizeof(bucket_t));
+        }
+    }
+    else
+    {
+        quotient = reserve_BigInt(n_buckets - d_buckets + 1);
+        remainder = reserve_BigInt(d_buckets);
+    }
+
+    if(quotient == NULL || remainder == NULL || 
+       quotient->value == NULL || remainder->value == NULL ||
+       (n_buckets >= d_buckets && 
+        !divide_buckets(quotient->value, remainder->value, n->value, n_buckets,
+                        d->value, d_buckets)))
+    {
+        if(quotient)
+        {
+            free_BigInt(quotient);
+        }
+        if(remainder)
+        {
+            free_BigInt(remainder);
+        }
+        return -1;
+    }
+
+    trim_BigInt(quotient, quotient->nbuckets);
+    trim_BigInt(remainder, remainder->nbuckets);
+
+    // Truncated division, the remainder takes the sign of the dividend
+    quotient->sign = equals_zero(quotient) ? 1 : n->sign * d->sign;
+    remainder->sign = equals_zero(remainder) ? 1 : n->sign;
+
+    if(q)
+    {
+        *q = quotient;
+    }
+    else
+    {
+        free_BigInt(quotient);
+    }
+    if(r)
+    {
+        *r = remainder;
+    }
+    else
+    {
+        free_BigInt(remainder);
+    }
+    return 0;
+}
+
+BigInt* divide(BigInt* n, BigInt* d)
+{
+    BigInt* quotient = NULL;
+    divmod(n, d, &quotient, NULL);
+    return quotient;
+}
+
+BigInt* mod(BigInt* n, BigInt* d)
+{
+    BigInt* remainder = NULL;
+    divmod(n, d, NULL, &remainder);
+    return remainder;
+}
+
+BigInt* pow_BigInt(BigInt* base, uint64_t e)
+{
+    if(base == NULL)
+    {
+        return NULL;
+    }
+
+    size_t nbuckets = leading_bucket(base);
+    bucket_t lead = base->value[nbuckets - 1];
+    int8_t sign = (base->sign < 0 && (e & 1)) ? -1 : 1;
+
+    // x^0 = 1, 0^e = 0 and 1^e = 1
+    if(e == 0 || (nbuckets == 1 && lead <= 1))
+    {
+        BigInt* result = val_BigInt((e == 0) ? 1 : lead);
+        if(result && !equals_zero(result))
+        {
+            result->sign = sign;
+        }
+        return result;
+    }
+
+    // base^e has at most bits * e bits, the buffers are sized for it up front
+    size_t bits = nbuckets * BUCKET_WIDTH - count_leading_zeros(lead);
+    if(e > (SIZE_MAX - 2 * BUCKET_WIDTH) / bits)
+    {
+        return NULL;
+    }
+
+    // A power of two only needs its single set bit moved
+    int power_of_two = (lead & (lead - 1)) == 0;
+    for(size_t i = 0; power_of_two && i + 1 < nbuckets; ++i)
+    {
+        power_of_two = base->value[i] == 0;
+    }
+    if(power_of_two)
+    {
+        size_t shift = (bits - 1) * e;
+        BigInt* result = reserve_BigInt(shift / BUCKET_WIDTH + 1);
+        if(result)
+        {
+            result->value[shift / BUCKET_WIDTH] = (bucket_t) 1 << (shift % BUCKET_WIDTH);
+            result->length = shift / BUCKET_WIDTH + 1;
+            result->sign = sign;
+        }
+        return result;
+    }
+
+    // Every intermediate square or product fits in size buckets
+    size_t size = bits * e / BUCKET_WIDTH + 2;
+
+    BigInt* result = reserve_BigInt(size);
+    bucket_t* other = (bucket_t*) bigint_malloc((size + multiply_scratch_size(size)) * 
+                                         sizeof(bucket_t));
+    if(result == NULL || result->value == NULL || other == NULL)
+    {
+        if(result)
+        {
+            free_BigInt(result);
+        }
+        bigint_free(other);
+        return NULL;
+    }
+    bucket_t* scratch = other + size;
+
+    // Left to right binary exponentiation, acc and other swap every step
+    bucket_t* acc = result->value;
+    size_t length = nbuckets;
+    memcpy(acc, base->value, nbuckets * sizeof(bucket_t));
+
+    unsigned bit = 63;
+    while(!((e >> bit) & 1))
+    {
+        --bit;
+    }
+    while(bit-- > 0)
+    {
+        sqr_dispatch(other, acc, length, scratch);
+        length *= 2;
+        if((e >> bit) & 1)
+        {
+            while(other[length - 1] == 0)
+            {
+                --length;
+            }
+            mul_dispatch(acc, other, length, base->value, nbuckets, scratch);
+            length += nbuckets;
+        }
+        else
+        {
+            bucket_t* swap = acc;
+            acc = other;
+            other = swap;
+        }
+        while(acc[length - 1] == 0)
+        {
+            --length;
+        }
+    }
+
+    if(acc != result->value)
+    {
+        memcpy(result->value, acc, length * sizeof(bucket_t));
+        other = acc;
+    }
+    memset(result->value + length, 0, (size - length) * sizeof(bucket_t));
+    result->length = length;
+    result->sign = sign;
+
+    bigint_free(other);
+    return result;
+}
+
+/*******************************************************************************
+* MODULAR ARITHMETIC
+*******************************************************************************/
+
+// Returns -m^-1 mod B for an odd m. Every Newton step doubles the number of 
+// correct low bits, an odd m is its own inverse to 3 bits
+static bucket_t negative_inverse(bucket_t m)
+{
+    bucket_t inverse = m;
+    while((bucket_t) (inverse * m) != 1)
+    {
+        inverse = (bucket_t) (inverse * (2 - inverse * m));
+    }
+    return (bucket_t) (0 - inverse);
+}
+
+// dest[0..n) = t[0..2n) * R^-1 mod modulus, t is destroyed. Each row clears
+// the lowest bucket of t, its carry is parked in the cleared bucket and added
+// to the top half at the end
+static void mont_reduce(const BigIntMontCtx* ctx, bucket_t* dest, bucket_t* t)
+{
+    size_t n = ctx->nbuckets;
+    for(size_t i = 0; i < n; ++i)
+    {
+        bucket_t u = (bucket_t) (t[i] * ctx->inverse);
+        t[i] = addmul_1(t + i, ctx->modulus, n, u);
+    }
+
+    // The sum is below 2 * modulus, one subtraction brings it into range. The
+    // difference is always computed and selected with a mask so the timing
+    // doesn't depend on the operands
+    bucket_t carry = add_n(dest, t + n, t, n);
+    bucket_t borrow = sub_n(t, dest, ctx->modulus, n);
+    bucket_t mask = (bucket_t) (0 - (carry | (borrow ^ 1)));
+    for(size_t i = 0; i < n; ++i)
+    {
+        dest[i] = (t[i] & mask) | (dest[i] & (bucket_t) ~mask);
+    }
+    return;
+}
+
+BigIntMontCtx* new_mont_ctx(BigInt* modulus)
+{
+    if(modulus == NULL || !(modulus->value[0] & 1))
+    {
+        return NULL;
+    }
+
+    BigIntMontCtx* ctx = (BigIntMontCtx*) bigint_malloc(sizeof(BigIntMontCtx));
+    if(ctx == NULL)
+    {
+        return NULL;
+    }
+
+    size_t n = leading_bucket(modulus);
+    ctx->nbuckets = n;
+    ctx->inverse = negative_inverse(modulus->value[0]);
+
+    // modulus and R^2 mod modulus, then the product and multiply scratch
+    ctx->modulus = allocate_buckets(2 * n + 2 * n + multiply_scratch_size(n));
+    if(ctx->modulus == NULL)
+    {
+        bigint_free(ctx);
+        return NULL;
+    }
+    ctx->r_squared = ctx->modulus + n;
+    ctx->scratch = ctx->r_squared + n;
+    memcpy(ctx->modulus, modulus->value, n * sizeof(bucket_t));
+
+    // Products of NTT_THRESHOLD buckets transform in buffers of the context
+    unsigned width;
+    size_t len;
+    ctx->products.ntt_memory = NULL;
+    ctx->products.ntt_length = 0;
+    if(n >= NTT_THRESHOLD && ntt_plan(n, n, &width, &len))
+    {
+        ctx->products.ntt_memory = (uint32_t*) bigint_malloc((NTT_PRIMES + 2) * 
+                                                             len * sizeof(uint32_t));
+        if(ctx->products.ntt_memory == NULL)
+        {
+            free_mont_ctx(ctx);
+            return NULL;
+        }
+        ctx->products.ntt_length = len;
+    }
+
+    // R^2 mod modulus is the only division the context ever performs
+    bucket_t* power = allocate_buckets(3 * n + 3);
+    int success = power != NULL;
+    if(success)
+    {
+        power[2 * n] = 1;
+        success = divide_buckets(power + 2 * n + 1, ctx->r_squared, 
+                                 power, 2 * n + 1, ctx->modulus, n);
+    }
+    bigint_free(power);
+
+    if(!success)
+    {
+        free_mont_ctx(ctx);
+        return NULL;
+    }
+    return ctx;
+}
+
+void free_mont_ctx(BigIntMontCtx* ctx)
+{
+    if(ctx)
+    {
+        bigint_free(ctx->products.ntt_memory);
+        bigint_free(ctx->modulus);
+        bigint_free(ctx);
+    }
+    return;
+}
+
+size_t mont_buckets(BigIntMontCtx* ctx)
+{
+    return (ctx != NULL) ? ctx->nbuckets : 0;
+}
+
+bucket_t* mont_mul(BigIntMontCtx* ctx, bucket_t* dest, const bucket_t* a, 
+                   const bucket_t* b)
+{
+    if(ctx == NULL || dest == NULL || a == NULL || b == NULL)
+    {
+        return NULL;
+    }
+    size_t n = ctx->nbuckets;
+
+    const product_workspace* previous = workspace;
+    workspace = &ctx->products;
+    mul_dispatch(ctx->scratch, a, n, b, n, ctx->scratch + 2 * n);
+    workspace = previous;
+    mont_reduce(ctx, dest, ctx->scratch);
+    return dest;
+}
+
+bucket_t* mont_sqr(BigIntMontCtx* ctx, bucket_t* dest, const bucket_t* a)
+{
+    if(ctx == NULL || dest == NULL || a == NULL)
+    {
+        return NULL;
+    }
+    size_t n = ctx->nbuckets;
+
+    const product_workspace* previous = workspace;
+    workspace = &ctx->products;
+    sqr_dispatch(ctx->scratch, a, n, ctx->scratch + 2 * n);
+    workspace = previous;
+    mont_reduce(ctx, dest, ctx->scratch);
+    return dest;
+}
+
+// mont_mul with the schoolbook kernels at every length. Their sequence of 
+// operations only depends on nbuckets, unlike Karatsuba and Toom-Cook 3 whose
+// middle terms branch on the operands. a == b squares
+static void mont_mul_basecase(BigIntMontCtx* ctx, bucket_t* dest, 
+                              const bucket_t* a, const bucket_t* b)
+{
+    size_t n = ctx->nbuckets;
+    if(a == b)
+    {
+        sqr_basecase(ctx->scratch, a, n);
+    }
+    else
+    {
+        mul_basecase(ctx->scratch, a, n, b, n);
+    }
+    mont_reduce(ctx, dest, ctx->scratch);
+    return;
+}
+
+bucket_t* to_mont(BigIntMontCtx* ctx, bucket_t* dest, const bucket_t* a)
+{
+    return (ctx != NULL) ? mont_mul(ctx, dest, a, ctx->r_squared) : NULL;
+}
+
+bucket_t* from_mont(BigIntMontCtx* ctx, bucket_t* dest, const bucket_t* a)
+{
+    if(ctx == NULL || dest == NULL || a == NULL)
+    {
+        return NULL;
+    }
+    size_t n = ctx->nbuckets;
+
+    memcpy(ctx->scratch, a, n * sizeof(bucket_t));
+    memset(ctx->scratch + n, 0, n * sizeof(bucket_t));
+    mont_reduce(ctx, dest, ctx->scratch);
+    return dest;
+}
+
+// Reduces window[0..w) with w <= 2k below the modulus of k buckets. The 
+// remainder is left in window[0..k) and the buckets above it are cleared
+static void barrett_reduce(BigIntBarrettCtx* ctx, bucket_t* window, size_t w)
+{
+    size_t k = ctx->nbuckets;
+    if(w < k)
+    {
+        // window < B^(k - 1) <= modulus
+        return;
+    }
+    bucket_t* q = ctx->scratch;
+    bucket_t* product = q + 2 * k + 3;
+    bucket_t* r = product + 2 * k + 3;
+    bucket_t* scratch = r + k + 1;
+
+    // q = ((window / B^(k - 1)) * reciprocal) / B^(k + 1) is the quotient or
+    // at most 2 below it (Handbook of Applied Cryptography, 14.42)
+    size_t qn = w - (k - 1);
+    mul_dispatch(q, window + k - 1, qn, ctx->reciprocal, 
+                 ctx->reciprocal_buckets, scratch);
+    qn += ctx->reciprocal_buckets;
+    qn = (qn > k + 1) ? qn - (k + 1) : 0;
+    q += k + 1;
+    while(qn > 0 && q[qn - 1] == 0)
+    {
+        --qn;
+    }
+
+    // r = (window - q * modulus) mod B^(k + 1), then at most 2 corrections
+    size_t low = (w < k + 1) ? w : k + 1;
+    memset(r, 0, (k + 1) * sizeof(bucket_t));
+    memcpy(r, window, low * sizeof(bucket_t));
+    if(qn > 0)
+    {
+        mul_dispatch(product, q, qn, ctx->modulus, k, scratch);
+        sub_n(r, r, product, k + 1);
+    }
+    while(r[k] != 0 || compare_buckets(r, k, ctx->modulus, k) >= 0)
+    {
+        r[k] -= sub_n(r, r, ctx->modulus, k);
+    }
+
+    memcpy(window, r, k * sizeof(bucket_t));
+    memset(window + k, 0, (w - k) * sizeof(bucket_t));
+    return;
+}
+
+BigIntBarrettCtx* new_barrett_ctx(BigInt* modulus)
+{
+    if(modulus == NULL || equals_zero(modulus))
+    {
+        return NULL;
+    }
+
+    BigIntBarrettCtx* ctx = (BigIntBarrettCtx*) bigint_malloc(sizeof(BigIntBarrettCtx));
+    if(ctx == NULL)
+    {
+        return NULL;
+    }
+
+    size_t k = leading_bucket(modulus);
+    ctx->nbuckets = k;
+    ctx->products.ntt_memory = NULL;
+    ctx->products.ntt_length = 0;
+
+    // modulus, the reciprocal, two products, the remainder and multiply scratch
+    ctx->modulus = allocate_buckets(k + (k + 2) + 2 * (2 * k + 3) + (k + 1) +
+                                    multiply_scratch_size(k + 2));
+    if(ctx->modulus == NULL)
+    {
+        bigint_free(ctx);
+        return NULL;
+    }
+    ctx->reciprocal = ctx->modulus + k;
+    ctx->scratch = ctx->reciprocal + k + 2;
+    memcpy(ctx->modulus, modulus->value, k * sizeof(bucket_t));
+
+    bucket_t* power = allocate_buckets(3 * k + 1);
+    int success = power != NULL;
+    if(success)
+    {
+        power[2 * k] = 1;
+        success = divide_buckets(ctx->reciprocal, power + 2 * k + 1, 
+                                 power, 2 * k + 1, ctx->modulus, k);
+    }
+    bigint_free(power);
+
+    if(!success)
+    {
+        free_barrett_ctx(ctx);
+        return NULL;
+    }
+
+    ctx->reciprocal_buckets = k + 2;
+    while(ctx->reciprocal[ctx->reciprocal_buckets - 1] == 0)
+    {
+        --ctx->reciprocal_buckets;
+    }
+    return ctx;
+}
+
+void free_barrett_ctx(BigIntBarrettCtx* ctx)
+{
+    if(ctx)
+    {
+        bigint_free(ctx->modulus);
+        bigint_free(ctx);
+    }
+    return;
+}
+
+BigInt* barrett_mod(BigIntBarrettCtx* ctx, BigInt* num)
+{
+    if(ctx == NULL || num == NULL)
+    {
+        return NULL;
+    }
+
+    size_t nbuckets = leading_bucket(num);
+
+    BigInt* result = reserve_BigInt(nbuckets);
+    if(result)
+    {
+        memcpy(result->value, num->value, nbuckets * sizeof(bucket_t));
+        result->length = nbuckets;
+        result->sign = num->sign;
+        barrett_mod_into(ctx, result);
+    }
+    return result;
+}
+
+BigInt* barrett_mod_into(BigIntBarrettCtx* ctx, BigInt* num)
+{
+    if(ctx == NULL || num == NULL)
+    {
+        return NULL;
+    }
+
+    // Reduces the top 2k buckets at a time, each pass leaves a k bucket 
+    // remainder that becomes the top of the next window
+    size_t k = ctx->nbuckets;
+    size_t top = leading_bucket(num);
+    size_t length = (top < k) ? top : k;
+    size_t start;
+    do
+    {
+        start = (top > 2 * k) ? top - 2 * k : 0;
+        barrett_reduce(ctx, num->value + start, top - start);
+        top = start + k;
+    } while(start > 0);
+    trim_BigInt(num, length);
+
+    if(equals_zero(num))
+    {
+        num->sign = 1;
+    }
+    return num;
+}
+
+// The modular multiplication used by powmod. Odd moduli are multiplied in
+// Montgomery form, even moduli are multiplied then Barrett reduced
+typedef struct residue_ring
+{
+    BigIntMontCtx* mont;
+    BigIntBarrettCtx* barrett;
+    bucket_t* product;
+    size_t nbuckets;
+    int basecase; // Products keep the fixed schedule of the basecase kernels
+} residue_ring;
+
+// dest[0..n) = a[0..n) * b[0..n) in the ring, dest may alias the operands
+static void ring_mul(residue_ring* ring, bucket_t* dest, const bucket_t* a,
+                     const bucket_t* b)
+{
+    size_t n = ring->nbuckets;
+    if(ring->mont && ring->basecase)
+    {
+        mont_mul_basecase(ring->mont, dest, a, b);
+    }
+    else if(ring->mont)
+    {
+        mont_mul(ring->mont, dest, a, b);
+    }
+    else
+    {
+        const product_workspace* previous = workspace;
+        workspace = &ring->barrett->products;
+        mul_dispatch(ring->product, a, n, b, n, ring->product + 2 * n);
+        barrett_reduce(ring->barrett, ring->product, 2 * n);
+        workspace = previous;
+        memcpy(dest, ring->product, n * sizeof(bucket_t));
+    }
+    return;
+}
+
+// Window width for an exponent of the given bit length. Wider windows trade a
+// larger table of powers for fewer multiplications
+static unsigned window_bits(size_t bits)
+{
+    return (bits > 671) ? 6 : (bits > 239) ? 5 : (bits > 79) ? 4 : 
+           (bits > 23)  ? 3 : 1;
+}
+
+// acc = g^e for a non zero e of ebits bits and ebuckets buckets, with a 
+// sliding window of odd powers. Runs of zero bits are only squared, every 
+// window starts and ends on a set bit
+static void powmod_sliding(residue_ring* ring, bucket_t* acc, const bucket_t* g,
+                           const bucket_t* e, size_t ebuckets, size_t ebits, 
+                           bucket_t* table)
+{
+    size_t n = ring->nbuckets;
+    unsigned k = window_bits(ebits);
+
+    // table[j] = g^(2j + 1), acc temporarily holds g^2
+    memcpy(table, g, n * sizeof(bucket_t));
+    ring_mul(ring, acc, g, g);
+    for(size_t j = 1; j < ((size_t) 1 << (k - 1)); ++j)
+    {
+        ring_mul(ring, table + j * n, table + (j - 1) * n, acc);
+    }
+
+    int started = 0;
+    for(size_t top = ebits; top > 0;)
+    {
+        if(get_chunk(e, ebuckets, top - 1, 1) == 0)
+        {
+            ring_mul(ring, acc, acc, acc);
+            --top;
+            continue;
+        }
+
+        unsigned width = (top < k) ? (unsigned) top : k;
+        while(get_chunk(e, ebuckets, top - width, 1) == 0)
+        {
+            --width;
+        }
+        const bucket_t* power = table + (get_chunk(e, ebuckets, top - width, 
+                                                   width) >> 1) * n;
+        top -= width;
+
+        if(started)
+        {
+            for(unsigned i = 0; i < width; ++i)
+            {
+                ring_mul(ring, acc, acc, acc);
+            }
+            ring_mul(ring, acc, acc, power);
+        }
+        else
+        {
+            memcpy(acc, power, n * sizeof(bucket_t));
+            started = 1;
+        }
+    }
+    return;
+}
+
+// dest = table[index], every entry is read and masked so the memory access 
+// pattern doesn't depend on index
+static void select_entry(bucket_t* dest, const bucket_t* table, size_t entries,
+                         size_t n, size_t index)
+{
+    memset(dest, 0, n * sizeof(bucket_t));
+    for(size_t j = 0; j < entries; ++j)
+    {
+        bucket_t mask = (bucket_t) (0 - (bucket_t) (j == index));
+        for(size_t i = 0; i < n; ++i)
+        {
+            dest[i] |= table[j * n + i] & mask;
+        }
+    }
+    return;
+}
+
+// acc = g^e with a fixed window. The same sequence of operations runs for
+// every exponent of ebuckets buckets, one is the ring's representation of 1
+static void powmod_fixed(residue_ring* ring, bucket_t* acc, const bucket_t* g,
+                         const bucket_t* one, const bucket_t* e, 
+                         size_t ebuckets, bucket_t* table, bucket_t* entry)
+{
+    size_t n = ring->nbuckets;
+    size_t ebits = ebuckets * BUCKET_WIDTH;
+    unsigned k = window_bits(ebits);
+    size_t entries = (size_t) 1 << k;
+
+    // table[j] = g^j
+    memcpy(table, one, n * sizeof(bucket_t));
+    memcpy(table + n, g, n * sizeof(bucket_t));
+    for(size_t j = 2; j < entries; ++j)
+    {
+        ring_mul(ring, table + j * n, table + (j - 1) * n, g);
+    }
+
+    memcpy(acc, one, n * sizeof(bucket_t));
+    for(size_t top = (ebits + k - 1) / k * k; top > 0; top -= k)
+    {
+        for(unsigned i = 0; i < k; ++i)
+        {
+            ring_mul(ring, acc, acc, acc);
+        }
+        select_entry(entry, table, entries, n, 
+                     get_chunk(e, ebuckets, top - k, k));
+        ring_mul(ring, acc, acc, entry);
+    }
+    return;
+}
+
+BigInt* powmod(BigInt* base, BigInt* exp, BigInt* modulus, int flags)
+{
+    if(base == NULL || exp == NULL || modulus == NULL || exp->sign < 0 || 
+       equals_zero(modulus))
+    {
+        return NULL;
+    }
+    int constant_time = flags & POWMOD_CONSTANT_TIME;
+    int odd = modulus->value[0] & 1;
+    if(constant_time && !odd)
+    {
+        return NULL;
+    }
+
+    size_t n = leading_bucket(modulus);
+    size_t ebuckets = leading_bucket(exp);
+    bucket_t lead = exp->value[ebuckets - 1];
+
+    // The constant time path treats every bucket of the exponent as significant
+    size_t ebits = ebuckets * BUCKET_WIDTH;
+    if(!constant_time)
+    {
+        ebits -= (lead != 0) ? count_leading_zeros(lead) : BUCKET_WIDTH;
+    }
+    size_t entries = (size_t) 1 << window_bits(ebits);
+
+    residue_ring ring = { NULL, NULL, NULL, n, constant_time };
+    if(odd)
+    {
+        ring.mont = new_mont_ctx(modulus);
+    }
+    else
+    {
+        ring.barrett = new_barrett_ctx(modulus);
+    }
+
+    // g, one, acc and entry, then the table of powers and the Barrett product
+    bucket_t* g = allocate_buckets((4 + entries) * n + 
+                                   (odd ? 0 : 2 * n + multiply_scratch_size(n)));
+    BigInt* reduced = mod(base, modulus);
+    BigInt* result = reserve_BigInt(n);
+
+    if((ring.mont || ring.barrett) && g && reduced && result)
+    {
+        bucket_t* one = g + n;
+        bucket_t* acc = one + n;
+        bucket_t* entry = acc + n;
+        bucket_t* table = entry + n;
+        ring.product = table + entries * n;
+
+        // g = base mod modulus in [0, modulus)
+        memcpy(g, reduced->value, leading_bucket(reduced) * sizeof(bucket_t));
+        if(reduced->sign < 0)
+        {
+            sub_n(g, modulus->value, g, n);
+        }
+        one[0] = 1;
+        if(ring.mont)
+        {
+            to_mont(ring.mont, g, g);
+            to_mont(ring.mont, one, one);
+        }
+
+        if(constant_time)
+        {
+            powmod_fixed(&ring, acc, g, one, exp->value, ebuckets, table, entry);
+        }
+        else if(ebits == 0)
+        {
+            memcpy(acc, one, n * sizeof(bucket_t));
+        }
+        else
+        {
+            powmod_sliding(&ring, acc, g, exp->value, ebuckets, ebits, table);
+        }
+
+        if(ring.mont)
+        {
+            from_mont(ring.mont, result->value, acc);
+        }
+        else
+        {
+            memcpy(result->value, acc, n * sizeof(bucket_t));
+        }
+        trim_BigInt(result, n);
+    }
+    else if(result)
+    {
+        free_BigInt(result);
+        result = NULL;
+    }
+
+    if(reduced)
+    {
+        free_BigInt(reduced);
+    }
+    bigint_free(g);
+    free_mont_ctx(ring.mont);
+    free_barrett_ctx(ring.barrett);
+    return result;
+}
+
+/*******************************************************************************
+* FIXED WIDTH INTEGERS
 *******************************************************************************/
 
-#if defined( BIGINT__x64 ) && !defined( __clang__ )
+// The bucket loops of the fixed width kernels have constant trip counts, GCC is
+// asked to unroll them completely at every width but the widest 8 bit ones
+#if defined( __GNUC__ ) && !defined( __clang__ ) && __GNUC__ >= 8
+    #define FIXED_UNROLL _Pragma("GCC unroll 32")
+#else
+    #define FIXED_UNROLL
+#endif
 
-static bucket_t add_with_carry(bucket_t *carry, bucket_t b1, bucket_t b2) 
+// Defines the kernels and conversions declared by DECLARE_FIXED_BIGINT
+#define DEFINE_FIXED_BIGINT(bits)                                              \
+bucket_t add_BigInt##bits(BigInt##bits* dest, const BigInt##bits* a,           \
+                          const BigInt##bits* b)                               \
+{                                                                              \
+    bucket_t carry = 0;                                                        \
+    FIXED_UNROLL                                                               \
+    for(size_t i = 0; i < FIXED_BIGINT_BUCKETS(bits); ++i)                     \
+    {                                                                          \
+        dest->value[i] = add_with_carry(&carry, a->value[i], b->value[i]);     \
+    }                                                                          \
+    return carry;                                                              \
+}                                                                              \
+                                                                               \
+bucket_t subtract_BigInt##bits(BigInt##bits* dest, const BigInt##bits* a,      \
+                               const BigInt##bits* b)                          \
+{                                                                              \
+    bucket_t borrow = 0;                                                       \
+    FIXED_UNROLL                                                               \
+    for(size_t i = 0; i < FIXED_BIGINT_BUCKETS(bits); ++i)                     \
+    {                                                                          \
+        dest->value[i] = subtract_with_carry(&borrow, a->value[i],             \
+                                             b->value[i]);                     \
+    }                                                                          \
+    return borrow;                                                             \
+}                                                                              \
+                                                                               \
+void multiply_BigInt##bits(BigInt##bits* dest, const BigInt##bits* a,          \
+                           const BigInt##bits* b)                              \
+{                                                                              \
+    /* Only the products that land below 2^bits are formed */                  \
+    bucket_t product[FIXED_BIGINT_BUCKETS(bits)] = { 0 };                      \
+    for(size_t i = 0; i < FIXED_BIGINT_BUCKETS(bits); ++i)                     \
+    {                                                                          \
+        bucket_t carry = 0;                                                    \
+        FIXED_UNROLL                                                           \
+        for(size_t j = 0; j < FIXED_BIGINT_BUCKETS(bits) - i; ++j)             \
+        {                                                                      \
+            product[i + j] = mul_add_with_carry(&carry, a->value[i],           \
+                                                b->value[j], product[i + j]);  \
+        }                                                                      \
+    }                                                                          \
+    memcpy(dest->value, product, sizeof(product));                             \
+    return;                                                                    \
+}                                                                              \
+                                                                               \
+int compare_BigInt##bits(const BigInt##bits* a, const BigInt##bits* b)         \
+{                                                                              \
+    int result = 0;                                                            \
+    FIXED_UNROLL                                                               \
+    for(size_t i = 0; i < FIXED_BIGINT_BUCKETS(bits); ++i)                     \
+    {                                                                          \
+        /* The most significant difference is the last one found */            \
+        result = (a->value[i] != b->value[i]) ?                                \
+                 ((a->value[i] < b->value[i]) ? -1 : 1) : result;              \
+    }                                                                          \
+    return result;                                                             \
+}                                                                              \
+                                                                               \
+int to_BigInt##bits(BigInt##bits* dest, BigInt* num)                           \
+{                                                                              \
+    if(dest == NULL || num == NULL || leading_bucket(num) >                    \
+       FIXED_BIGINT_BUCKETS(bits) || (num->sign < 0 && !equals_zero(num)))     \
+    {                                                                          \
+        return -1;                                                             \
+    }                                                                          \
+    memset(dest->value, 0, sizeof(dest->value));                               \
+    memcpy(dest->value, num->value, leading_bucket(num) * sizeof(bucket_t));   \
+    return 0;                                                                  \
+}                                                                              \
+                                                                               \
+BigInt* from_BigInt##bits(const BigInt##bits* num)                             \
+{                                                                              \
+    if(num == NULL)                                                            \
+    {                                                                          \
+        return NULL;                                                           \
+    }                                                                          \
+    BigInt* new_int = reserve_BigInt(FIXED_BIGINT_BUCKETS(bits));              \
+    if(new_int == NULL || new_int->value == NULL)                              \
+    {                                                                          \
+        if(new_int)                                                            \
+        {                                                                      \
+            free_BigInt(new_int);                                              \
+        }                                                                      \
+        return NULL;                                                           \
+    }                                                                          \
+    memcpy(new_int->value, num->value, sizeof(num->value));                    \
+    return trim_BigInt(new_int, FIXED_BIGINT_BUCKETS(bits));                   \
+}
+
+// Defines multiply_wide_BigInt##bits, the full product of two bits wide
+// integers into one of wide bits
+#define DEFINE_FIXED_BIGINT_WIDE(bits, wide)                                   \
+void multiply_wide_BigInt##bits(BigInt##wide* dest, const BigInt##bits* a,     \
+                                const BigInt##bits* b)                         \
+{                                                                              \
+    bucket_t product[FIXED_BIGINT_BUCKETS(wide)] = { 0 };                      \
+    for(size_t i = 0; i < FIXED_BIGINT_BUCKETS(bits); ++i)                     \
+    {                                                                          \
+        bucket_t carry = 0;                                                    \
+        FIXED_UNROLL                                                           \
+        for(size_t j = 0; j < FIXED_BIGINT_BUCKETS(bits); ++j)                 \
+        {                                                                      \
+            product[i + j] = mul_add_with_carry(&carry, a->value[i],           \
+                                                b->value[j], product[i + j]);  \
+        }                                                                      \
+        product[i + FIXED_BIGINT_BUCKETS(bits)] = carry;                       \
+    }                                                                          \
+    memcpy(dest->value, product, sizeof(product));                             \
+    return;                                                                    \
+}
+
+DEFINE_FIXED_BIGINT(256)
+DEFINE_FIXED_BIGINT(512)
+DEFINE_FIXED_BIGINT(1024)
+DEFINE_FIXED_BIGINT_WIDE(256, 512)
+DEFINE_FIXED_BIGINT_WIDE(512, 1024)
+
+/*******************************************************************************
+* RADIX CONVERSION
+*******************************************************************************/
+
+/*
+ * A string in a base that isn't a power of two is cut into chunks of the most
+ * digits whose value always fits a bucket, each chunk is then one digit in the
+ * big base base^digits. Short runs of chunks are combined by Horner's rule, 
+ * long runs are split in two and recombined as high * big_base^m + low with 
+ * the powers big_base^(2^k) squared up once, so the cost follows the 
+ * multiplication tiers rather than growing quadratically
+ */
+
+// Returns the number of base digits in a chunk, stores base^digits in big_base
+static unsigned chunk_digits(unsigned base, bucket_t* big_base)
 {
-    bucket_t sum;
-    bucket_t carry_in = *carry;
-    uint8_t carry_out;
+    unsigned digits = 1;
+    bucket_t power = base;
+    while(power <= BUCKET_MAX_SIZE / base)
+    {
+        power *= base;
+        ++digits;
+    }
+    *big_base = power;
+    return digits;
+}
 
-    asm(
-        "xorq	%0, %0\n\t"
-        "cmpq   %4, %0\n\t"
-        "movq	%2, %0\n\t"
-        "adcq	%3, %0\n\t"
-        "setc	%1\n\t"
-        : "=&rm" (sum), "=&rm"(carry_out)
-        : "rm" (b1), "rm" (b2), "r" (carry_in)
-        : "cc"
-    );
+// Returns log2(base) if base is a power of two, otherwise 0
+static unsigned power_of_two_bits(unsigned base)
+{
+    unsigned bits = 0;
+    if((base & (base - 1)) == 0)
+    {
+        while((1u << bits) < base)
+        {
+            ++bits;
+        }
+    }
+    return bits;
+}
+
+// Packs the digits of [start, end) bits at a time into the zeroed dest
+static void fill_power_of_two(bucket_t* dest, const char* start, 
+                              const char* end, unsigned base, unsigned bits)
+{
+    for(size_t bit = 0; end-- > start; bit += bits)
+    {
+        bucket_t digit = (bucket_t) char_to_num(*end, base);
+        size_t offset = bit % BUCKET_WIDTH;
+
+        dest[bit / BUCKET_WIDTH] |= (bucket_t) (digit << offset);
+        if(offset + bits > BUCKET_WIDTH)
+        {
+            dest[bit / BUCKET_WIDTH + 1] |= digit >> (BUCKET_WIDTH - offset);
+        }
+    }
+    return;
+}
+
+// Stores the value of each chunk of digits into chunks, least significant 
+// first. Only the most significant chunk may be short
+static void fill_chunks(bucket_t* chunks, const char* start, const char* end, 
+                        unsigned base, unsigned digits)
+{
+    while(end > start)
+    {
+        const char* chunk = ((size_t) (end - start) > digits) ? end - digits : start;
+        bucket_t value = 0;
+        for(const char* digit = chunk; digit < end; ++digit)
+        {
+            value = value * base + (bucket_t) char_to_num(*digit, base);
+        }
+        *chunks++ = value;
+        end = chunk;
+    }
+    return;
+}
+
+// dest[0..n) = the value of chunks[0..n) by Horner's rule
+static void radix_basecase(bucket_t* dest, const bucket_t* chunks, size_t n,
+                           bucket_t big_base)
+{
+    size_t length = 0;
+    for(size_t i = n; i-- > 0;)
+    {
+        // dest = dest * big_base + chunk in one pass, the chunk is the carry in
+        bucket_t carry = chunks[i];
+        for(size_t j = 0; j < length; ++j)
+        {
+            dest[j] = mul_add_with_carry(&carry, dest[j], big_base, 0);
+        }
+        if(carry != 0)
+        {
+            dest[length++] = carry;
+        }
+    }
+    memset(dest + length, 0, (n - length) * sizeof(bucket_t));
+    return;
+}
+
+// The powers big_base^(2^k) that split a run of chunks
+typedef struct radix_powers
+{
+    bucket_t* value[sizeof(size_t) * 8];
+    size_t length[sizeof(size_t) * 8];
+} radix_powers;
+
+// Squares big_base up to the largest power needed by n chunks. Power k is 
+// stored in 2^k buckets of powers_buffer, 2n buckets in total 
+static void radix_fill_powers(radix_powers* powers, bucket_t* powers_buffer, 
+                              size_t n, bucket_t big_base, bucket_t* scratch)
+{
+    powers->value[0] = powers_buffer;
+    powers->value[0][0] = big_base;
+    powers->length[0] = 1;
+    for(unsigned k = 0; ((size_t) 2 << k) < n; ++k)
+    {
+        size_t length = powers->length[k];
+        bucket_t* square = powers->value[k] + ((size_t) 1 << k);
+
+        sqr_dispatch(square, powers->value[k], length, scratch);
+        length *= 2;
+        while(square[length - 1] == 0)
+        {
+            --length;
+        }
+        powers->value[k + 1] = square;
+        powers->length[k + 1] = length;
+    }
+    return;
+}
+
+// dest[0..n) = the value of chunks[0..n). The low part is the largest power of
+// two count of chunks below n, which keeps every low part an exact power. The
+// scratch holds 3n + multiply_scratch_size(n) buckets
+static void radix_from_chunks(bucket_t* dest, const bucket_t* chunks, size_t n,
+                              bucket_t big_base, const radix_powers* powers, 
+                              bucket_t* scratch)
+{
+    if(n < RADIX_DC_THRESHOLD)
+    {
+        radix_basecase(dest, chunks, n, big_base);
+        return;
+    }
+
+    unsigned k = 0;
+    while(((size_t) 2 << k) < n)
+    {
+        ++k;
+    }
+    size_t m = (size_t) 1 << k;
+    bucket_t* low = scratch;
+    bucket_t* high = scratch + m;
+
+    radix_from_chunks(low, chunks, m, big_base, powers, scratch + n);
+    radix_from_chunks(high, chunks + m, n - m, big_base, powers, scratch + n);
+
+    // high < big_base^(n - m) and big_base^m < B^m so the product fits in n
+    // buckets. Inside the low part a run of zero chunks can leave high zero
+    size_t high_length = n - m;
+    while(high_length > 0 && high[high_length - 1] == 0)
+    {
+        --high_length;
+    }
+    size_t product_length = (high_length > 0) ? high_length + powers->length[k] : 0;
+
+    if(high_length > 0)
+    {
+        mul_dispatch(dest, high, high_length, powers->value[k], 
+                     powers->length[k], scratch + n);
+    }
+    memset(dest + product_length, 0, (n - product_length) * sizeof(bucket_t));
+    add_buckets(dest, dest, n, low, m);
+    return;
+}
+
+BigInt* str_base_BigInt(const char* str_num, int base)
+{
+    if(base == 16)
+    {
+        return str_BigInt(str_num);
+    }
+
+    const char* start = NULL;
+    const char* end = NULL;
+    int8_t sign = (base >= 2 && base <= 36) ? 
+                  format_base_string(str_num, base, &start, &end) : 0;
+
+    if(sign == 0) // format_base_string failed, do not parse string
+    {
+        return empty_BigInt();
+    }
+
+    size_t digits = end - start;
+    unsigned bits = power_of_two_bits(base);
+    if(bits != 0)
+    {
+        BigInt* new_int = reserve_BigInt((digits * bits + BUCKET_WIDTH - 1) / BUCKET_WIDTH);
+        if(new_int)
+        {
+            new_int->sign = sign;
+            fill_power_of_two(new_int->value, start, end, base, bits);
+            trim_BigInt(new_int, new_int->nbuckets);
+        }
+        return new_int;
+    }
+
+    bucket_t big_base = 0;
+    unsigned per_chunk = chunk_digits(base, &big_base);
+    size_t n = (digits + per_chunk - 1) / per_chunk;
+
+    // Every chunk is below B, so n chunks never need more than n buckets
+    BigInt* new_int = reserve_BigInt(n);
+    bucket_t* chunks = (bucket_t*) bigint_malloc(n * sizeof(bucket_t));
+    if(new_int == NULL || new_int->value == NULL || chunks == NULL)
+    {
+        if(new_int)
+        {
+            free_BigInt(new_int);
+        }
+        bigint_free(chunks);
+        return NULL;
+    }
+    new_int->sign = sign;
+    fill_chunks(chunks, start, end, base, per_chunk);
+
+    if(n < RADIX_DC_THRESHOLD)
+    {
+        radix_basecase(new_int->value, chunks, n, big_base);
+        bigint_free(chunks);
+        return trim_BigInt(new_int, n);
+    }
+
+    size_t workspace = 2 * n + (3 * n + multiply_scratch_size(n));
+    bucket_t* powers_buffer = (bucket_t*) bigint_malloc(workspace * sizeof(bucket_t));
+    if(powers_buffer == NULL)
+    {
+        free_BigInt(new_int);
+        bigint_free(chunks);
+        return NULL;
+    }
+    bucket_t* scratch = powers_buffer + 2 * n;
+
+    radix_powers powers;
+    radix_fill_powers(&powers, powers_buffer, n, big_base, scratch);
+    radix_from_chunks(new_int->value, chunks, n, big_base, &powers, scratch);
+
+    bigint_free(powers_buffer);
+    bigint_free(chunks);
+    return trim_BigInt(new_int, n);
+}
+
+/*
+ * Output runs the other way. The value is written as a fixed count of chunks, 
+ * each padded to its full digits, and divided by big_base^m into a top and a 
+ * bottom part that are written independently. Leading zeroes are stripped at 
+ * the end, so the buffer must hold the padded length
+ */
+
+static const char radix_digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+// Returns the number of chunks that always hold a value of the given bits,
+// each chunk holds at least floor(log2(big_base)) bits
+static size_t radix_chunks(size_t bits, unsigned base)
+{
+    bucket_t big_base = 0;
+    chunk_digits(base, &big_base);
+    size_t chunk_bits = BUCKET_WIDTH - 1 - count_leading_zeros(big_base);
+    return (bits + chunk_bits - 1) / chunk_bits;
+}
+
+// Writes value as exactly width digits of base ending one before end
+static void write_chunk(char* end, bucket_t value, unsigned base, unsigned width)
+{
+    while(width-- > 0)
+    {
+        *--end = radix_digits[value % base];
+        value /= base;
+    }
+    return;
+}
+
+// Writes x[0..n) < big_base^c as exactly c chunks of digits to out by 
+// dividing out one chunk at a time. x is destroyed
+static void radix_to_chars_basecase(char* out, bucket_t* x, size_t n, size_t c,
+                                    unsigned base)
+{
+    bucket_t big_base = 0;
+    unsigned per_chunk = chunk_digits(base, &big_base);
+
+    for(char* end = out + c * per_chunk; end > out; end -= per_chunk)
+    {
+        while(n > 0 && x[n - 1] == 0)
+        {
+            --n;
+        }
+        bucket_t chunk = (n > 0) ? divrem_1(x, x, n, big_base) : 0;
+        write_chunk(end, chunk, base, per_chunk);
+    }
+    return;
+}
+
+// Writes x[0..n) < big_base^c as exactly c chunks of digits to out. The split
+// is at m chunks, the largest power of two below c, so every divisor is one of
+// the squared powers. x is destroyed and scratch holds 3n + 128 buckets. 
+// Returns 0 if a division could not allocate
+static int radix_to_chars(char* out, bucket_t* x, size_t n, size_t c, 
+                          unsigned base, const radix_powers* powers, 
+                          bucket_t* scratch)
+{
+    while(n > 0 && x[n - 1] == 0)
+    {
+        --n;
+    }
+    if(n < RADIX_DC_THRESHOLD)
+    {
+        radix_to_chars_basecase(out, x, n, c, base);
+        return 1;
+    }
+
+    bucket_t big_base = 0;
+    unsigned per_chunk = chunk_digits(base, &big_base);
+
+    unsigned k = 0;
+    while(((size_t) 2 << k) < c)
+    {
+        ++k;
+    }
+    size_t m = (size_t) 1 << k;
+    char* bottom = out + (c - m) * per_chunk;
+    const bucket_t* power = powers->value[k];
+    size_t power_length = powers->length[k];
+
+    // x is shorter than the power, the top part is zero
+    if(n < power_length)
+    {
+        memset(out, '0', bottom - out);
+        return radix_to_chars(bottom, x, n, m, base, powers, scratch);
+    }
 
-    *carry = carry_out;
-    return sum;
+    size_t quotient_length = n - power_length + 1;
+    bucket_t* quotient = scratch;
+    bucket_t* remainder = scratch + quotient_length;
+    scratch = remainder + power_length;
+
+    return divide_buckets(quotient, remainder, x, n, power, power_length) &&
+           radix_to_chars(out, quotient, quotient_length, c - m, base, powers, 
+                          scratch) &&
+           radix_to_chars(bottom, remainder, power_length, m, base, powers, 
+                          scratch);
 }
 
-static bucket_t subtract_with_carry(bucket_t* carry, bucket_t b1, bucket_t b2)
+// Writes x[0..n) to out in a power of two base by reading bits from x, out
+// holds exactly digits characters. The first least significant digits are
+// already written
+static void radix_to_chars_power_of_two(char* out, const bucket_t* x, size_t n,
+                                        size_t digits, size_t first, 
+                                        unsigned bits)
 {
-    bucket_t sum;
-    bucket_t carry_in = *carry;
-    uint8_t carry_out;
-
-    asm(
-        "xorq	%0, %0\n\t"
-        "cmpq   %4, %0\n\t"
-        "movq	%2, %0\n\t"
-        "sbbq	%3, %0\n\t"
-        "setc	%1\n\t"
-        : "=&rm" (sum), "=&rm"(carry_out)
-        : "rm" (b1), "rm" (b2), "r" (carry_in)
-        : "cc"
-    );
+    bucket_t mask = (bucket_t) ((1u << bits) - 1);
+    for(size_t i = first, bit = first * bits; i < digits; ++i, bit += bits)
+    {
+        size_t index = bit / BUCKET_WIDTH;
+        size_t offset = bit % BUCKET_WIDTH;
 
-    *carry = carry_out;
-    return sum;
+        bucket_t digit = x[index] >> offset;
+        if(offset + bits > BUCKET_WIDTH && index + 1 < n)
+        {
+            digit |= x[index + 1] << (BUCKET_WIDTH - offset);
+        }
+        out[digits - 1 - i] = radix_digits[digit & mask];
+    }
+    return;
 }
 
-#elif defined( BIGINT__x86 ) && !defined( __clang__ )
-
-static bucket_t add_with_carry(bucket_t *carry, bucket_t b1, bucket_t b2) 
+size_t to_string_length(BigInt* num, int base)
 {
-    bucket_t sum;
-    bucket_t carry_in = *carry;
-    uint8_t carry_out;
+    if(num == NULL || base < 2 || base > 36)
+    {
+        return 0;
+    }
 
-    asm(
-        "xorl	%0, %0\n\t"
-        "cmpl   %4, %0\n\t"
-        "movl	%2, %0\n\t"
-        "adcl	%3, %0\n\t"
-        "setc	%1\n\t"
-        : "=&rm" (sum), "=&rm"(carry_out)
-        : "rm" (b1), "rm" (b2), "r" (carry_in)
-        : "cc"
-    );
+    size_t nbuckets = leading_bucket(num);
+    size_t bits = nbuckets * BUCKET_WIDTH;
+    bits -= (num->value[nbuckets - 1] != 0) ? 
+            count_leading_zeros(num->value[nbuckets - 1]) : BUCKET_WIDTH - 1;
 
-    *carry = carry_out;
-    return sum;
+    unsigned power_bits = power_of_two_bits(base);
+    if(power_bits != 0)
+    {
+        return (bits + power_bits - 1) / power_bits + 2;
+    }
+
+    bucket_t big_base = 0;
+    return radix_chunks(bits, base) * chunk_digits(base, &big_base) + 2;
 }
 
-static bucket_t subtract_with_carry(bucket_t* carry, bucket_t b1, bucket_t b2)
+size_t to_string(BigInt* num, int base, char* buf, size_t len)
 {
-    bucket_t sum;
-    bucket_t carry_in = *carry;
-    uint8_t carry_out;
+    size_t length = to_string_length(num, base);
+    if(length == 0 || buf == NULL || len < length)
+    {
+        return 0;
+    }
 
-    asm(
-        "xorl	%0, %0\n\t"
-        "cmpl   %4, %0\n\t"
-        "movl	%2, %0\n\t"
-        "sbbl	%3, %0\n\t"
-        "setc	%1\n\t"
-        : "=&rm" (sum), "=&rm"(carry_out)
-        : "rm" (b1), "rm" (b2), "r" (carry_in)
-        : "cc"
-    );
+    size_t nbuckets = leading_bucket(num);
+    char* out = buf;
+    if(num->sign < 0 && !equals_zero(num))
+    {
+        *out++ = '-';
+    }
 
-    *carry = carry_out;
-    return sum;}
+    // length counts the sign and the terminator
+    size_t digits = length - 2;
+    unsigned power_bits = power_of_two_bits(base);
+    if(power_bits != 0)
+    {
+        // Hex is written 16 digits at a time below the leading group
+        size_t first = (base == 16) ? write_hex_groups(out, num->value, nbuckets, 
+                                                       digits) : 0;
+        radix_to_chars_power_of_two(out, num->value, nbuckets, digits, first, 
+                                    power_bits);
+        out[digits] = '\0';
+        return out - buf + digits;
+    }
 
-#else // defined( BIGINT__8bit ) || defined ( __clang__ )
+    bucket_t big_base = 0;
+    size_t c = digits / chunk_digits(base, &big_base);
 
-static bucket_t add_with_carry(bucket_t* carry, bucket_t b1, bucket_t b2) 
-{
-    bucket_t sum = b1;
+    if(nbuckets < RADIX_DC_THRESHOLD)
+    {
+        // Small values are converted on the stack without allocating
+        bucket_t x[RADIX_DC_THRESHOLD];
+        memcpy(x, num->value, nbuckets * sizeof(bucket_t));
+        radix_to_chars_basecase(out, x, nbuckets, c, base);
+    }
+    else
+    {
+        size_t scratch_length = 3 * nbuckets + 128;
+        if(scratch_length < multiply_scratch_size(c))
+        {
+            scratch_length = multiply_scratch_size(c);
+        }
 
-    uint8_t carry_in = (sum += *carry) < b1 ? 1 : 0;
+        bucket_t* x = (bucket_t*) bigint_malloc((nbuckets + 2 * c + scratch_length) * 
+                                         sizeof(bucket_t));
+        if(x == NULL)
+        {
+            return 0;
+        }
+        bucket_t* powers_buffer = x + nbuckets;
+        bucket_t* scratch = powers_buffer + 2 * c;
+        memcpy(x, num->value, nbuckets * sizeof(bucket_t));
 
-    uint8_t carry_out = (sum += b2) < b2 ? 1 : carry_in;
+        radix_powers powers;
+        radix_fill_powers(&powers, powers_buffer, c, big_base, scratch);
+        int converted = radix_to_chars(out, x, nbuckets, c, base, &powers, scratch);
 
-    *carry = carry_out;
+        bigint_free(x);
+        if(!converted)
+        {
+            return 0;
+        }
+    }
 
-    return sum;
+    // Strips the padding of the leading chunk, keeping one digit for zero
+    size_t zeroes = 0;
+    while(zeroes + 1 < digits && out[zeroes] == '0')
+    {
+        ++zeroes;
+    }
+    digits -= zeroes;
+    memmove(out, out + zeroes, digits);
+    out[digits] = '\0';
+    return out - buf + digits;
 }
 
-static bucket_t subtract_with_carry(bucket_t* carry, bucket_t b1, bucket_t b2)
-{
-    bucket_t sum = b1;
-
-    uint8_t carry_in = (sum -= *carry) > b1 ? 1 : 0;
-
-    uint8_t carry_out = (sum -= b2) > b2 && b2 != 0 ? 1 : carry_in;
+/*******************************************************************************
+* BINARY IMPORT/EXPORT
+*******************************************************************************/
 
-    *carry = carry_out;
+/*
+ * Whole buckets are moved with memcpy and byte swapped when the byte order 
+ * differs from the host, the bytes of a partial leading bucket one at a time.
+ * Little endian bytes on a little endian host are the bucket array itself
+ */
 
-    return sum;
+static int host_is_little_endian(void)
+{
+    const uint16_t one = 1;
+    return *(const uint8_t*) &one;
 }
 
+// Returns val with its bytes in reverse order
+static bucket_t swap_bucket(bucket_t val)
+{
+#if defined( __GNUC__ ) && !defined( BIGINT__8bit )
+    return (sizeof(bucket_t) == 8) ? (bucket_t) __builtin_bswap64(val) 
+                                   : (bucket_t) __builtin_bswap32((uint32_t) val);
+#else
+    bucket_t swapped = 0;
+    for(size_t i = 0; i < sizeof(bucket_t); ++i)
+    {
+        swapped = (bucket_t) ((swapped << 8) | (uint8_t) val);
+        val = (bucket_t) (val >> 8);
+    }
+    return swapped;
 #endif
+}
 
-
-static BigInt* evaluate(BigInt* b1, BigInt* b2, BigInt* dest, 
-                        bucket_t (*operation)(bucket_t*, bucket_t, bucket_t))
+// Returns non zero if endian selects little endian bytes
+static int is_little_endian(int endian)
 {
-    size_t b1_buckets = leading_bucket(b1);
-    size_t b2_buckets = leading_bucket(b2);
+    return endian < 0 || (endian == 0 && host_is_little_endian());
+}
 
-    bucket_t carry_out = 0;
+BigInt* import_bytes(const uint8_t* bytes, size_t len, int endian)
+{
+    if(bytes == NULL && len > 0)
+    {
+        return NULL;
+    }
 
-    size_t i = 0;
-    for(; i < b2_buckets; ++i)
+    size_t nbuckets = (len + sizeof(bucket_t) - 1) / sizeof(bucket_t);
+    BigInt* new_int = reserve_BigInt((nbuckets > 0) ? nbuckets : 1);
+    if(new_int == NULL || new_int->value == NULL)
     {
-        dest->value[i] = operation(&carry_out, b1->value[i], b2->value[i]);
+        if(new_int)
+        {
+            free_BigInt(new_int);
+        }
+        return NULL;
     }
-    for(; i < b1_buckets; ++i)
+
+    bucket_t* value = new_int->value;
+    int little = is_little_endian(endian);
+    int swap = little != host_is_little_endian();
+    if(little && !swap && len > 0)
     {
-        dest->value[i] = operation(&carry_out, b1->value[i], 0);
+        memcpy(value, bytes, len);
+        return trim_BigInt(new_int, nbuckets);
     }
-    dest->value[i] = carry_out;
 
-    return dest;
+    // Bucket i is the i-th group of sizeof(bucket_t) bytes from the least
+    // significant end
+    size_t full = len / sizeof(bucket_t);
+    for(size_t i = 0; i < full; ++i)
+    {
+        const uint8_t* group = little ? bytes + i * sizeof(bucket_t) 
+                                      : bytes + len - (i + 1) * sizeof(bucket_t);
+        memcpy(value + i, group, sizeof(bucket_t));
+        value[i] = swap ? swap_bucket(value[i]) : value[i];
+    }
+    for(size_t i = full * sizeof(bucket_t); i < len; ++i)
+    {
+        uint8_t byte = little ? bytes[i] : bytes[len - 1 - i];
+        value[full] |= (bucket_t) byte << (8 * (i % sizeof(bucket_t)));
+    }
+    return trim_BigInt(new_int, nbuckets);
 }
 
-BigInt* add(BigInt* b1, BigInt* b2)
+size_t byte_length(BigInt* num)
 {
-    if(b1 == NULL || b2 == NULL)
+    if(num == NULL)
     {
-        return NULL;
+        return 0;
     }
 
-    // XOR the signs, if both are negative perform add. If either is negative
-    // perform subtract
-    bucket_t (*operation)(bucket_t*, bucket_t, bucket_t) = 
-        (!(b2->sign < 0) && b1->sign < 0) || (b2->sign < 0 && !(b1->sign < 0)) ? 
-        subtract_with_carry : add_with_carry;
+    size_t nbuckets = leading_bucket(num);
+    bucket_t lead = num->value[nbuckets - 1];
+    size_t lead_bits = (lead != 0) ? BUCKET_WIDTH - count_leading_zeros(lead) : 1;
+    return (nbuckets - 1) * sizeof(bucket_t) + (lead_bits + 7) / 8;
+}
 
-    BigInt* result;
-    int b2_is_bigger = compare_bigint(b2, b1) > 0;
-    if(b2_is_bigger)
+size_t export_bytes(BigInt* num, uint8_t* buf, size_t len, int endian)
+{
+    size_t length = byte_length(num);
+    if(length == 0 || buf == NULL || len < length)
     {
-        result = reserve_BigInt(b2->nbuckets + 1);
-        evaluate(b2, b1, result, operation);
+        return 0;
     }
-    else
+
+    const bucket_t* value = num->value;
+    int little = is_little_endian(endian);
+    int swap = little != host_is_little_endian();
+    if(little && !swap)
     {
-        result = reserve_BigInt(b1->nbuckets + 1);
-        evaluate(b1, b2, result, operation);
+        memcpy(buf, value, length);
+        return length;
     }
 
-    int negative = (operation == subtract_with_carry && b1->sign > 0);
-    if((negative && b2_is_bigger) || (b1->sign < 0 && !b2_is_bigger))
+    size_t full = length / sizeof(bucket_t);
+    for(size_t i = 0; i < full; ++i)
     {
-        result->sign = -1;
+        bucket_t bucket = swap ? swap_bucket(value[i]) : value[i];
+        uint8_t* group = little ? buf + i * sizeof(bucket_t) 
+                                : buf + length - (i + 1) * sizeof(bucket_t);
+        memcpy(group, &bucket, sizeof(bucket_t));
     }
-    return result;
+    for(size_t i = full * sizeof(bucket_t); i < length; ++i)
+    {
+        uint8_t byte = (uint8_t) (value[full] >> (8 * (i % sizeof(bucket_t))));
+        buf[little ? i : length - 1 - i] = byte;
+    }
+    return length;
 }
 
-BigInt* add_into(BigInt* src, BigInt* dest)
+/*******************************************************************************
+* SERIALIZATION
+*******************************************************************************/
+
+/*
+ * A saved BigInt is a 16 byte header followed by its buckets as one little 
+ * endian magnitude. The header holds the magic "BINT", the format version, 
+ * the bucket width in bytes of the writer, the sign, a reserved zero byte and 
+ * the bucket count as a little endian 64 bit integer. Reading the buckets as
+ * bytes makes files portable across bucket widths, and a file of the reader's
+ * width maps directly onto a little endian host's bucket array
+ */
+
+#define BIGINT_FILE_VERSION 1
+#define BIGINT_FILE_HEADER 16
+
+static uint64_t header_count(const uint8_t* header)
 {
-    if(src == NULL || dest == NULL)
+    uint64_t count = 0;
+    for(int i = 8; i-- > 0;)
     {
-        return NULL;
+        count = (count << 8) | header[8 + i];
     }
+    return count;
+}
 
-    // XOR the signs, if both are negative perform add. If either is negative
-    // perform subtract
-    bucket_t (*operation)(bucket_t*, bucket_t, bucket_t) = 
-        (!(dest->sign < 0) && src->sign < 0) || 
-        (dest->sign < 0 && !(src->sign < 0)) ? 
-        subtract_with_carry : add_with_carry;
+// Validates header, stores the sign, bucket width and the byte length of the
+// buckets that follow it. Returns 0 if the header is invalid
+static int read_header(const uint8_t* header, int8_t* sign, size_t* width, 
+                       size_t* bytes)
+{
+    *width = header[5];
+    *sign = (int8_t) header[6];
+    uint64_t count = header_count(header);
 
-    int src_is_bigger = compare_bigint(src, dest) > 0;
-    if(src_is_bigger)
+    if(memcmp(header, "BINT", 4) != 0 || header[4] != BIGINT_FILE_VERSION ||
+       (*width != 1 && *width != 4 && *width != 8) || (*sign != 1 && *sign != -1) ||
+       count > (SIZE_MAX - BIGINT_FILE_HEADER) / *width)
     {
-        grow_BigInt(dest, src->nbuckets - dest->nbuckets + 1);
-        evaluate(src, dest, dest, operation);
+        return 0;
     }
-    else
+    *bytes = (size_t) count * *width;
+    return 1;
+}
+
+static void release_buckets(BigInt* num)
+{
+    if(num->storage == BUCKETS_OWNED)
     {
-        evaluate(dest, src, dest, operation);
+        bigint_free(num->value);
     }
-
-    int negative = (operation == subtract_with_carry && dest->sign > 0);
-    if((negative && src_is_bigger) || (dest->sign < 0 && !src_is_bigger))
+#ifdef BIGINT_MMAP
+    else if(num->storage == BUCKETS_MAPPED)
     {
-        dest->sign = -1;
+        // The mapping starts with the file header, which still holds its size
+        uint8_t* header = (uint8_t*) num->value - BIGINT_FILE_HEADER;
+        munmap(header, BIGINT_FILE_HEADER + header_count(header) * sizeof(bucket_t));
     }
-    return dest;
+#endif
+    return;
 }
 
-BigInt* subtract(BigInt* b1, BigInt* b2)
+int save_BigInt(BigInt* num, FILE* file)
 {
-    if(b1 == NULL || b2 == NULL)
+    if(num == NULL || file == NULL)
     {
-        return NULL;
+        return -1;
     }
 
-    // flipping the sign will result in the correct operation
-    b2->sign = b2->sign * -1;
+    size_t nbuckets = leading_bucket(num);
+    uint8_t header[BIGINT_FILE_HEADER] = { 'B', 'I', 'N', 'T', BIGINT_FILE_VERSION,
+                                           sizeof(bucket_t) };
+    header[6] = (uint8_t) ((num->sign < 0 && !equals_zero(num)) ? -1 : 1);
+    for(int i = 0; i < 8; ++i)
+    {
+        header[8 + i] = (uint8_t) ((uint64_t) nbuckets >> (8 * i));
+    }
+    if(fwrite(header, 1, sizeof(header), file) != sizeof(header))
+    {
+        return -1;
+    }
 
-    BigInt* result = add(b1, b2);
+    if(host_is_little_endian())
+    {
+        return (fwrite(num->value, sizeof(bucket_t), nbuckets, file) == nbuckets) ? 0 : -1;
+    }
+    for(size_t i = 0; i < nbuckets; ++i)
+    {
+        bucket_t bucket = swap_bucket(num->value[i]);
+        if(fwrite(&bucket, sizeof(bucket_t), 1, file) != 1)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
 
-    b2->sign = b2->sign * -1;
+BigInt* load_BigInt(FILE* file)
+{
+    uint8_t header[BIGINT_FILE_HEADER];
+    int8_t sign = 1;
+    size_t width = 0;
+    size_t bytes = 0;
 
-    return result;
+    if(file == NULL || fread(header, 1, sizeof(header), file) != sizeof(header) ||
+       !read_header(header, &sign, &width, &bytes))
+    {
+        return NULL;
+    }
+
+    // The little endian magnitude is read straight into the buckets, which
+    // are already in order on a little endian host whatever the file's width
+    size_t nbuckets = (bytes + sizeof(bucket_t) - 1) / sizeof(bucket_t);
+    BigInt* new_int = reserve_BigInt((nbuckets > 0) ? nbuckets : 1);
+    if(new_int == NULL || new_int->value == NULL || 
+       fread(new_int->value, 1, bytes, file) != bytes)
+    {
+        if(new_int)
+        {
+            free_BigInt(new_int);
+        }
+        return NULL;
+    }
+    for(size_t i = 0; !host_is_little_endian() && i < nbuckets; ++i)
+    {
+        new_int->value[i] = swap_bucket(new_int->value[i]);
+    }
+    trim_BigInt(new_int, nbuckets);
+    new_int->sign = equals_zero(new_int) ? 1 : sign;
+    return new_int;
 }
 
-BigInt* subtract_from(BigInt* src, BigInt* dest)
+BigInt* map_BigInt(const char* path)
 {
-    if(src == NULL || dest == NULL)
+    if(path == NULL)
+    {
+        return NULL;
+    }
+
+#ifdef BIGINT_MMAP
+    int fd = open(path, O_RDONLY);
+    if(fd < 0)
     {
         return NULL;
     }
-    src->sign = src->sign * -1;
 
-    add_into(src, dest);
+    uint8_t header[BIGINT_FILE_HEADER];
+    int8_t sign = 1;
+    size_t width = 0;
+    size_t bytes = 0;
+    struct stat file_stat;
+    uint8_t* mapping = NULL;
 
-    src->sign = src->sign * -1;
+    // Only a file of this build's bucket width on a little endian host can be 
+    // used in place. The private mapping is copy on write, so in place 
+    // arithmetic never reaches the file
+    if(pread(fd, header, sizeof(header), 0) == (ssize_t) sizeof(header) &&
+       read_header(header, &sign, &width, &bytes) && width == sizeof(bucket_t) &&
+       bytes > 0 && host_is_little_endian() && fstat(fd, &file_stat) == 0 &&
+       (uint64_t) file_stat.st_size >= BIGINT_FILE_HEADER + (uint64_t) bytes)
+    {
+        mapping = (uint8_t*) mmap(NULL, BIGINT_FILE_HEADER + bytes, 
+                                  PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        mapping = (mapping == MAP_FAILED) ? NULL : mapping;
+    }
+    close(fd);
 
-    return dest;
+    if(mapping)
+    {
+        BigInt* new_int = (BigInt*) bigint_malloc(sizeof(BigInt));
+        if(new_int == NULL)
+        {
+            munmap(mapping, BIGINT_FILE_HEADER + bytes);
+            return NULL;
+        }
+        new_int->value = (bucket_t*) (mapping + BIGINT_FILE_HEADER);
+        new_int->nbuckets = bytes / sizeof(bucket_t);
+        new_int->storage = BUCKETS_MAPPED;
+        trim_BigInt(new_int, new_int->nbuckets);
+        new_int->sign = equals_zero(new_int) ? 1 : sign;
+        return new_int;
+    }
+#endif
+
+    // Files of another width or byte order are read into a copy
+    FILE* file = fopen(path, "rb");
+    if(file == NULL)
+    {
+        return NULL;
+    }
+    BigInt* new_int = load_BigInt(file);
+    fclose(file);
+    return new_int;
 }
 
 /*******************************************************************************
@@ -509,55 +5369,90 @@ BigInt* subtract_from(BigInt* src, BigInt* dest)
 
 void free_BigInt(BigInt* num)
 {
-    free(num->value);
-    free(num);
+    release_buckets(num);
+    bigint_free(num);
     return;
 }
 
 void display(BigInt* num)
 {
-    size_t lead_bucket = leading_bucket(num);
-
-    printf("%s", (num->sign < 0) ? "-0x" : "0x");
+    size_t length = to_string_length(num, 16);
+    char* hex = (char*) bigint_malloc(length);
 
-#ifdef BIGINT__x86
-    printf("%x", num->value[lead_bucket]);
-#else
-    // Cast is so the 8bit debug build can use the %lx formatter
-    printf("%lx", (uint64_t) num->value[--lead_bucket]);
-#endif
-
-    rfor_each(num->value, --lead_bucket, display_bucket);
-
-    printf("\n");
+    if(hex && to_string(num, 16, hex, length))
+    {
+        int negative = hex[0] == '-';
+        printf("%s%s\n", negative ? "-0x" : "0x", hex + negative);
+    }
+    bigint_free(hex);
 
     return;
 }
 
 BigInt* clear_BigInt(BigInt* num)
 {
-    for(size_t i = 0; i < num->nbuckets; ++i)
+    // Only the used buckets can be non zero
+    memset(num->value, 0, num->length * sizeof(bucket_t));
+    num->length = 1;
+    num->sign = 1;
+    return num;
+}
+
+BigInt* reserve_capacity(BigInt* num, size_t capacity)
+{
+    if(num == NULL || (capacity > num->nbuckets && !resize_buckets(num, capacity)))
     {
-        num->value[i] = 0;
+        return NULL;
+    }
+    return num;
+}
+
+BigInt* shrink_to_fit(BigInt* num)
+{
+    if(num == NULL || (num->length < num->nbuckets && 
+                       !resize_buckets(num, num->length)))
+    {
+        return NULL;
     }
-    num->sign = 1;
     return num;
 }
 
 int compare_bigint(BigInt* lhs, BigInt* rhs)
 {
-    size_t b1 = leading_bucket(lhs);
-    size_t b2 = leading_bucket(rhs);
-    int result = b1 - b2;
+    return compare_buckets(lhs->value, leading_bucket(lhs), 
+                           rhs->value, leading_bucket(rhs));
+}
 
-    return (result == 0) ? (int)(lhs->value[b1 - 1] - rhs->value[b2 - 1]) : result;
+int compare_batch(int* results, BigInt* const* lhs, BigInt* const* rhs, 
+                  size_t count)
+{
+    if(results == NULL || lhs == NULL || rhs == NULL)
+    {
+        return -1;
+    }
+    for(size_t i = 0; i < count; ++i)
+    {
+        if(lhs[i] == NULL || rhs[i] == NULL)
+        {
+            return -1;
+        }
+    }
+    for(size_t i = 0; i < count; ++i)
+    {
+        results[i] = compare_bigint(lhs[i], rhs[i]);
+    }
+    return 0;
 }
 
 int compare_uint(BigInt* lhs, bucket_t rhs)
 {
     if(lhs)
     {
-        return lhs->value[0] - rhs;
+        if(leading_bucket(lhs) > 1 || lhs->value[0] > rhs)
+        {
+            return 1;
+        }
+        return (lhs->value[0] < rhs) ? -1 : 0;
     }
     return rhs;
 }
@@ -590,13 +5485,9 @@ int hex_digits(BigInt* num)
 {
     if(num != NULL)
     {
-        // Finds the leading bucket value
-        size_t i = num->nbuckets - 1;
-        for(; i > 0  && num->value[i] == 0; --i);
-
         // Return leading digits plus the number of digits for each full bucket
-        return count_hex_digits(num->value[i]) 
-               + (num->nbuckets - (num->nbuckets - i)) * 2 * sizeof(bucket_t);
+        size_t i = leading_bucket(num) - 1;
+        return count_hex_digits(num->value[i]) + i * 2 * sizeof(bucket_t);
     }
     return -1;
 }
@@ -607,21 +5498,6 @@ int hex_digits(BigInt* num)
 
 #ifdef MOCKING_ENABLED
 
-// Deprecated now that BigInt only supports hexadecimal input
-static int char_to_num(char c, int base)
-{
-    c = tolower(c);
-
-    // Default base is 10
-    base = (base < 2 || base > 36) ? 10 : base;
-
-    char upper_alphabetic_limit = 'a' + base - 11;
-    char upper_numeric_limit = (base < 10) ? '0' + base - 1 : '9';
-
-    return (c >= '0' && c <= upper_numeric_limit)   ? c - '0' :
-           (c >= 'a'&& c <= upper_alphabetic_limit) ? c - 'a' + 10 : -1;
-}
-
 static bucket_t* get_buckets(BigInt* num)
 {
     return num->value;
@@ -631,6 +5507,7 @@ const mock_bigint m_bigint = {
     .char_to_num = char_to_num,
     .format_string = format_string,
     .add_carry = add_with_carry,
+    .mul_add_carry = mul_add_with_carry,
     .get_buckets = get_buckets
 };
 
@@ -7,10 +7,13 @@
  *
  */
 
+#include <algorithm>
 #include <random>
 #include <chrono>
 #include <climits>
 #include <iostream>
+#include <string>
+#include <vector>
 #include "catch.hpp"
 
 extern "C" {
@@ -29,6 +32,45 @@ sbucket_t any_int(sbucket_t min, sbucket_t max)
     return u_dist(generator);
 }
 
+#ifdef MOCKING_ENABLED
+
+// Returns B^n - 1, a BigInt with n buckets of BUCKET_MAX_SIZE
+BigInt* all_ones(int nbuckets)
+{
+    std::string digits(nbuckets * 2 * sizeof(bucket_t), 'f');
+    return str_BigInt(("0x" + digits).c_str());
+}
+
+// (B^n - 1) * (B^m - 1) = B^(n + m) - B^n - B^m + 1, with n >= m the buckets
+// are 1, m - 1 zeroes, n - m maxes, max - 1 then m - 1 maxes
+bool is_expected_product(BigInt* product, int n, int m)
+{
+    bucket_t* values = m_bigint.get_buckets(product);
+    bool expected = values[0] == 1;
+    for (int i = 1; i < n + m; ++i)
+    {
+        bucket_t digit = (i < m) ? 0 : (i == n) ? BUCKET_MAX_SIZE - 1 
+                                                : BUCKET_MAX_SIZE;
+        expected = expected && values[i] == digit;
+    }
+    return expected && buckets(product) == n + m;
+}
+
+// Copies num into an array of exactly n buckets, the operand format of the
+// Montgomery functions
+std::vector<bucket_t> to_buckets(BigInt* num, int n)
+{
+    std::vector<bucket_t> values(n, 0);
+    bucket_t* source = m_bigint.get_buckets(num);
+    for (int i = 0; i < n && i < buckets(num); ++i)
+    {
+        values[i] = source[i];
+    }
+    return values;
+}
+
+#endif
+
 TEST_CASE("Constructing BigInt's with values <= BUCKET_MAX_SIZE", "[constructors]")
 {
     SECTION("default constructor returns an empty BigInt")
@@ -81,247 +123,1436 @@ TEST_CASE("Constructing BigInt's with values <= BUCKET_MAX_SIZE", "[constructors
     }
 }
 
-TEST_CASE("Determining sign of a BigInt", "[sign]")
+TEST_CASE("Constructing BigInts from strings in other bases", "[str_base_BigInt]")
 {
-    SECTION("Negative BigInt returns sign < 0")
+    SECTION("Invalid bases and strings return a BigInt with 0 value")
     {
-        BigInt* num = str_BigInt("-0xffff");
-        REQUIRE(sign(num) < 0);
+        const char* strings[] = { "12a", "0x10", "-", "" };
+        for (const char* str : strings)
+        {
+            BigInt* num = str_base_BigInt(str, 10);
+            REQUIRE(compare_uint(num, 0) == 0);
+            free_BigInt(num);
+        }
+
+        BigInt* num = str_base_BigInt("10", 1);
+        REQUIRE(compare_uint(num, 0) == 0);
+        free_BigInt(num);
+
+        num = str_base_BigInt("10", 37);
+        REQUIRE(compare_uint(num, 0) == 0);
         free_BigInt(num);
     }
-    SECTION("Positive BigInt returns sign > 0")
+    SECTION("Small values in every kind of base")
     {
-        BigInt* num = str_BigInt("0xffff");
-        REQUIRE(sign(num) > 0);
-        free_BigInt(num);
+        struct { const char* str; int base; const char* hex; } cases[] = {
+            { "  255", 10, "0xff" }, { "-0xff", 16, "-0xff" }, { "00101", 2, "0x5" },
+            { "Zz", 36, "0x50f" }, { "-7777", 8, "-0xfff" }, { "-1210", 3, "-0x30" } };
+        for (auto& c : cases)
+        {
+            BigInt* num = str_base_BigInt(c.str, c.base);
+            BigInt* expected = str_BigInt(c.hex);
+
+            REQUIRE(compare_bigint(num, expected) == 0);
+            REQUIRE(sign(num) == sign(expected));
+
+            free_BigInt(num);
+            free_BigInt(expected);
+        }
     }
-    SECTION("Empty BigInt returns sign > 0")
+    SECTION("Decimal values larger than a bucket")
     {
-        BigInt* num = empty_BigInt();
-        REQUIRE(sign(num) > 0);
+        BigInt* num = str_base_BigInt("-12345678901234567890123456789", 10);
+        BigInt* expected = str_BigInt("-0x27e41b3246bec9b16e398115");
+
+        REQUIRE(compare_bigint(num, expected) == 0);
+        REQUIRE(sign(num) < 0);
+
         free_BigInt(num);
+        free_BigInt(expected);
     }
-    SECTION("Passing NULL to sign() returns 0")
+    SECTION("Long strings are combined in halves")
     {
-        BigInt* num = NULL;
-        REQUIRE(sign(num) == 0);
+        // Powers of the base have long runs of zero chunks
+        int digits = 8 * RADIX_DC_THRESHOLD * BUCKET_WIDTH / 3 + 5;
+        for (int base : { 3, 10 })
+        {
+            std::string power = "1" + std::string(digits, '0');
+            BigInt* num = str_base_BigInt(power.c_str(), base);
+            BigInt* radix = val_BigInt(base);
+            BigInt* expected = pow_BigInt(radix, digits);
+
+            REQUIRE(compare_bigint(num, expected) == 0);
+
+            // base^digits - 1 is every digit at its largest
+            std::string largest(digits, '0' + base - 1);
+            BigInt* one = val_BigInt(1);
+            BigInt* below = str_base_BigInt(largest.c_str(), base);
+            BigInt* difference = subtract(expected, below);
+
+            REQUIRE(compare_bigint(difference, one) == 0);
+
+            free_BigInt(num);
+            free_BigInt(radix);
+            free_BigInt(expected);
+            free_BigInt(one);
+            free_BigInt(below);
+            free_BigInt(difference);
+        }
     }
 }
 
-TEST_CASE("Determining the number of hex_digits in a BigInt", "[hex_digits]")
+TEST_CASE("Writing BigInts as strings in other bases", "[to_string]")
 {
-    SECTION("Number of hexadecimal digits")
+    SECTION("Invalid arguments write nothing")
     {
-        // 81985529216486895 DEC
-        BigInt* num = str_BigInt("0x123456789abcdef");
-        REQUIRE(hex_digits(num) == 15);
+        char buf[16];
+        BigInt* num = val_BigInt(10);
+
+        REQUIRE(to_string_length(NULL, 10) == 0);
+        REQUIRE(to_string_length(num, 37) == 0);
+        REQUIRE(to_string(NULL, 10, buf, sizeof(buf)) == 0);
+        REQUIRE(to_string(num, 1, buf, sizeof(buf)) == 0);
+        REQUIRE(to_string(num, 10, NULL, sizeof(buf)) == 0);
+        REQUIRE(to_string(num, 10, buf, to_string_length(num, 10) - 1) == 0);
+
         free_BigInt(num);
     }
-    SECTION("Passing null to hex_digits return -1")
+    SECTION("Small values in every kind of base")
     {
-        REQUIRE(hex_digits(NULL) == -1);
+        struct { const char* hex; int base; const char* str; } cases[] = {
+            { "0xff", 10, "255" }, { "-0xff", 16, "-ff" }, { "0x5", 2, "101" },
+            { "0x50f", 36, "zz" }, { "-0xfff", 8, "-7777" }, { "0x0", 10, "0" },
+            { "-0x27e41b3246bec9b16e398115", 10, "-12345678901234567890123456789" } };
+        for (auto& c : cases)
+        {
+            BigInt* num = str_BigInt(c.hex);
+            std::vector<char> buf(to_string_length(num, c.base));
+
+            REQUIRE(to_string(num, c.base, buf.data(), buf.size()) == std::string(c.str).size());
+            REQUIRE(std::string(buf.data()) == c.str);
+
+            free_BigInt(num);
+        }
     }
-    SECTION("Number of hex_digits on a zero valued bigint = 1")
+    SECTION("Long values are split in halves")
     {
-        BigInt* num = str_BigInt("0x000000000000000000");
-        REQUIRE(num != NULL);
-        REQUIRE(hex_digits(num) == 1);
-        free_BigInt(num);
+        int digits = 8 * RADIX_DC_THRESHOLD * BUCKET_WIDTH / 3 + 5;
+        for (int base : { 3, 10 })
+        {
+            std::string power = "1" + std::string(digits, '0');
+            std::string largest(digits, '0' + base - 1);
+
+            for (const std::string& str : { power, largest })
+            {
+                BigInt* num = str_base_BigInt(str.c_str(), base);
+                std::vector<char> buf(to_string_length(num, base));
+
+                REQUIRE(to_string(num, base, buf.data(), buf.size()) == str.size());
+                REQUIRE(std::string(buf.data()) == str);
+
+                free_BigInt(num);
+            }
+        }
     }
 }
 
-#ifdef MOCKING_ENABLED
+TEST_CASE("Hex strings are converted in blocks", "[str_BigInt][to_string]")
+{
+    // Lengths cross the 16 and 32 digit blocks and the bucket boundaries
+    const std::string digits = "1aB2c3De4f5A6b7C8d9E0f";
 
-TEST_CASE("Constructing BigInts with values > BUCKET_MAX_SIZE", "[constructors]")
+    SECTION("Every length round trips")
+    {
+        for (size_t length = 1; length <= 100; ++length)
+        {
+            std::string hex;
+            for (size_t i = 0; i < length; ++i)
+            {
+                hex += digits[(i * 7) % digits.size()];
+            }
+            std::string lower = hex;
+            for (char& c : lower)
+            {
+                c = tolower(c);
+            }
+
+            BigInt* num = str_BigInt(("-0x" + hex).c_str());
+            std::vector<char> buf(to_string_length(num, 16));
+
+            REQUIRE(to_string(num, 16, buf.data(), buf.size()) == length + 1);
+            REQUIRE(std::string(buf.data()) == "-" + lower);
+
+            free_BigInt(num);
+        }
+    }
+    SECTION("An invalid character anywhere fails the whole string")
+    {
+        std::string hex(70, 'f');
+        for (size_t i = 0; i < hex.size(); ++i)
+        {
+            std::string invalid = hex;
+            invalid[i] = (i % 2) ? 'g' : '@';
+
+            BigInt* num = str_BigInt(invalid.c_str());
+            REQUIRE(compare_uint(num, 0) == 0);
+            REQUIRE(buckets(num) == 1);
+            free_BigInt(num);
+        }
+    }
+}
+
+TEST_CASE("Importing and exporting bytes", "[import_bytes][export_bytes]")
 {
-    // To make these tests easier to write/debug most of them are written only 
-    // for the 8bit configuration, the final composite test tests all 
-    // configurations.
-    #ifdef BIGINT__8bit 
-    SECTION("Even number of digits")
+    const uint8_t big[] = { 0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef, 
+                            0xfe, 0xdc, 0xba };
+    const char* hex = "0x0123456789abcdeffedcba";
+
+    SECTION("Invalid arguments")
     {
-        const char* test_str = "0x1000";
-        BigInt* num = str_BigInt(test_str);
+        uint8_t buf[16];
+        BigInt* num = val_BigInt(1);
 
-        bucket_t* values = m_bigint.get_buckets(num);
+        REQUIRE(import_bytes(NULL, 1, BIGINT_BIG_ENDIAN) == NULL);
+        REQUIRE(byte_length(NULL) == 0);
+        REQUIRE(export_bytes(NULL, buf, sizeof(buf), BIGINT_BIG_ENDIAN) == 0);
+        REQUIRE(export_bytes(num, NULL, sizeof(buf), BIGINT_BIG_ENDIAN) == 0);
+        REQUIRE(export_bytes(num, buf, 0, BIGINT_BIG_ENDIAN) == 0);
 
-        REQUIRE(buckets(num) == 2);
-        REQUIRE(values[0] == 0);
-        REQUIRE(values[1] == 16);
         free_BigInt(num);
     }
-    SECTION("string with odd number of digits")
+    SECTION("Both byte orders")
     {
-        const char* test_str = "0x1234567";
-        bucket_t expected_values[] = { 103, 69, 35, 1 };
-
-        BigInt* num = str_BigInt(test_str);
-        bucket_t* values = m_bigint.get_buckets(num);
-
-        REQUIRE(buckets(num) == 4);
-        for(int i = 0; i < 4; ++i)
+        uint8_t little[sizeof(big)];
+        for (size_t i = 0; i < sizeof(big); ++i)
         {
-            REQUIRE(expected_values[i] == values[i]);
+            little[i] = big[sizeof(big) - 1 - i];
         }
+        BigInt* expected = str_BigInt(hex);
 
-        free_BigInt(num);
+        BigInt* from_big = import_bytes(big, sizeof(big), BIGINT_BIG_ENDIAN);
+        BigInt* from_little = import_bytes(little, sizeof(little), BIGINT_LITTLE_ENDIAN);
+        REQUIRE(compare_bigint(from_big, expected) == 0);
+        REQUIRE(compare_bigint(from_little, expected) == 0);
+        REQUIRE(sign(from_big) > 0);
+
+        uint8_t buf[sizeof(big)];
+        REQUIRE(byte_length(expected) == sizeof(big));
+        REQUIRE(export_bytes(expected, buf, sizeof(buf), BIGINT_BIG_ENDIAN) == sizeof(big));
+        REQUIRE(std::equal(buf, buf + sizeof(buf), big));
+        REQUIRE(export_bytes(expected, buf, sizeof(buf), BIGINT_LITTLE_ENDIAN) == sizeof(big));
+        REQUIRE(std::equal(buf, buf + sizeof(buf), little));
+
+        free_BigInt(expected);
+        free_BigInt(from_big);
+        free_BigInt(from_little);
     }
-    SECTION("Leading zeroes are ignored")
+    SECTION("Zero is one byte and the sign is dropped")
     {
-        const char* test_str = "0x000000100ff";
-        bucket_t expected_values[] = { 255, 0, 1 };
+        BigInt* zero = import_bytes(NULL, 0, BIGINT_NATIVE_ENDIAN);
+        BigInt* negative = str_BigInt("-0x1ff");
+        uint8_t buf[4];
 
-        BigInt* num = str_BigInt(test_str);
-        bucket_t* values = m_bigint.get_buckets(num);
+        REQUIRE(compare_uint(zero, 0) == 0);
+        REQUIRE(export_bytes(zero, buf, sizeof(buf), BIGINT_BIG_ENDIAN) == 1);
+        REQUIRE(buf[0] == 0);
+        REQUIRE(export_bytes(negative, buf, sizeof(buf), BIGINT_BIG_ENDIAN) == 2);
+        REQUIRE((buf[0] == 0x01 && buf[1] == 0xff));
 
-        REQUIRE(buckets(num) == 3);
-        for(int i = 0; i < 3; ++i)
+        free_BigInt(zero);
+        free_BigInt(negative);
+    }
+    SECTION("A view uses the caller's buckets until it grows")
+    {
+        bucket_t values[] = { 5, 0 };
+        BigInt* view = view_BigInt(values, 2);
+
+        REQUIRE(view_BigInt(NULL, 2) == NULL);
+        REQUIRE(view_BigInt(values, 0) == NULL);
+        REQUIRE(compare_uint(view, 5) == 0);
+
+        // The buckets aren't copied
+        values[0] = 6;
+        REQUIRE(compare_uint(view, 6) == 0);
+
+        // Squaring replaces the buckets, the caller's array is left alone
+        square_into(view);
+        REQUIRE(compare_uint(view, 36) == 0);
+        REQUIRE((values[0] == 6 && values[1] == 0));
+
+        free_BigInt(view);
+    }
+}
+
+TEST_CASE("Saving and loading BigInts", "[save_BigInt][load_BigInt][map_BigInt]")
+{
+    const char* path = "BigInt_save_test.bin";
+    const char* hex = "-0x123456789abcdeffedcba9876543210f";
+
+    SECTION("Invalid arguments and files")
+    {
+        BigInt* num = val_BigInt(1);
+        FILE* file = tmpfile();
+
+        REQUIRE(save_BigInt(NULL, file) == -1);
+        REQUIRE(save_BigInt(num, NULL) == -1);
+        REQUIRE(load_BigInt(NULL) == NULL);
+        REQUIRE(map_BigInt(NULL) == NULL);
+        REQUIRE(map_BigInt("BigInt_missing_file.bin") == NULL);
+
+        // A bad magic and a truncated file
+        fputs("BINX", file);
+        rewind(file);
+        REQUIRE(load_BigInt(file) == NULL);
+
+        rewind(file);
+        REQUIRE(save_BigInt(num, file) == 0);
+        fflush(file);
+        FILE* truncated = tmpfile();
+        rewind(file);
+        for (int i = 0; i < 16; ++i)
         {
-            REQUIRE(expected_values[i] == values[i]);
+            fputc(fgetc(file), truncated);
         }
+        rewind(truncated);
+        REQUIRE(load_BigInt(truncated) == NULL);
 
+        fclose(file);
+        fclose(truncated);
         free_BigInt(num);
     }
-    SECTION("Large negative value")
+    SECTION("Round trip through a file")
     {
-        const char* test_str = "-0x123456789abcdef";
-        bucket_t expected_values[] = { 239, 205, 171, 137, 103, 69, 35, 1 };
+        BigInt* num = str_BigInt(hex);
+        FILE* file = fopen(path, "wb");
+        REQUIRE(save_BigInt(num, file) == 0);
+        fclose(file);
 
-        BigInt* num = str_BigInt(test_str);
-        bucket_t* values = m_bigint.get_buckets(num);
+        file = fopen(path, "rb");
+        BigInt* loaded = load_BigInt(file);
+        fclose(file);
+        BigInt* mapped = map_BigInt(path);
 
-        REQUIRE(buckets(num) == 8);
-        for(int i = 0; i < 8; ++i)
-        {
-            REQUIRE(expected_values[i] == values[i]);
-        }
+        REQUIRE(compare_bigint(loaded, num) == 0);
+        REQUIRE(compare_bigint(mapped, num) == 0);
+        REQUIRE(sign(loaded) < 0);
+        REQUIRE(sign(mapped) < 0);
+
+        // In place arithmetic on the mapping doesn't reach the file
+        square_into(mapped);
+        free_BigInt(mapped);
+        mapped = map_BigInt(path);
+        REQUIRE(compare_bigint(mapped, num) == 0);
 
         free_BigInt(num);
+        free_BigInt(loaded);
+        free_BigInt(mapped);
+        remove(path);
     }
-    #endif
-
-    SECTION("Composite Test")
+    SECTION("Files of every bucket width are read")
     {
-        const char* test_str = "\t\t  \n-001112233445566778899aabbccddeeff  \t";
-        #ifdef BIGINT__8bit
-        uint8_t expected_values[] = {
-            0xff, 0xee, 0xdd, 0xcc, 0xbb, 0xaa, 0x99, 0x88, 
-            0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11, 0x1
-        };
-        int nbuckets = 16;
-        #else
-        #ifdef BIGINT__x64
-        uint64_t expected_values[] = {
-            0x8899aabbccddeeff, 0x111223344556677
-        };
-        int nbuckets = 2;
-        #else // BIGINT__x86
-        uint32_t expected_values[] = {
-            0xccddeeff, 0x8899aabb, 0x44556677, 0x1112233
-        };
-        int nbuckets = 4;
-        #endif
-        #endif
-
-        BigInt* num = str_BigInt(test_str);
-        bucket_t* values = m_bigint.get_buckets(num);
+        // The value is 0x0123456789abcdef00ffeeddccbbaa99 in 1, 4 and 8 byte
+        // buckets, little endian after the header
+        const uint8_t magnitude[] = { 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff, 0x00,
+                                      0xef, 0xcd, 0xab, 0x89, 0x67, 0x45, 0x23, 0x01 };
+        BigInt* expected = str_BigInt("0x0123456789abcdef00ffeeddccbbaa99");
 
-        REQUIRE(buckets(num) == nbuckets);
-        for(int i = 0; i < nbuckets; ++i)
+        for (uint8_t width : { 1, 4, 8 })
         {
-            REQUIRE(expected_values[i] == values[i]);
+            uint8_t header[16] = { 'B', 'I', 'N', 'T', 1, width, 1, 0, 
+                                   (uint8_t) (sizeof(magnitude) / width) };
+            FILE* file = fopen(path, "wb");
+            fwrite(header, 1, sizeof(header), file);
+            fwrite(magnitude, 1, sizeof(magnitude), file);
+            fclose(file);
+
+            file = fopen(path, "rb");
+            BigInt* loaded = load_BigInt(file);
+            fclose(file);
+            BigInt* mapped = map_BigInt(path);
+
+            REQUIRE(compare_bigint(loaded, expected) == 0);
+            REQUIRE(compare_bigint(mapped, expected) == 0);
+
+            free_BigInt(loaded);
+            free_BigInt(mapped);
         }
-        free_BigInt(num);
+        free_BigInt(expected);
+        remove(path);
     }
 }
 
-TEST_CASE("Adding with carry_in and carry_out", "[add_with_carry]")
+TEST_CASE("Managing the capacity of a BigInt", "[reserve_capacity][shrink_to_fit]")
 {
-    bucket_t carry_in = 1;
-
-    SECTION("Carry in 1, add 0 + 0 returns 1, carry_out 0")
-    {
-        int result = m_bigint.add_carry(&carry_in, 0, 0);
-        REQUIRE(result == 1);
-        REQUIRE(carry_in == 0);
-    }
-    SECTION("Carry in 0, add 0 + 0 returns 0, carry out 0")
+    SECTION("An accumulator grows geometrically")
     {
-        carry_in = 0;
-        REQUIRE(m_bigint.add_carry(&carry_in, 0, 0) == 0);
-        REQUIRE(carry_in == 0);
+        BigInt* num = val_BigInt(1);
+        int resizes = 0;
+        for(int i = 0; i < 40 * BUCKET_WIDTH; ++i)
+        {
+            int capacity = buckets(num);
+            REQUIRE(add_into(num, num) == num);
+            resizes += buckets(num) != capacity;
+        }
+
+        // 2^(40 * BUCKET_WIDTH) takes 41 buckets
+        BigInt* expected = str_base_BigInt(("1" + std::string(40 * BUCKET_WIDTH, '0')).c_str(), 2);
+        REQUIRE(compare_bigint(num, expected) == 0);
+        REQUIRE(buckets(num) >= 41);
+        REQUIRE(resizes < 16);
+        free_BigInt(num);
+        free_BigInt(expected);
     }
-    SECTION("Carry in 0, add BUCKET_MAX_SIZE + 0 returns BUCKET_MAX_SIZE, carry out 0")
+    SECTION("Reserving and shrinking keeps the value")
     {
-        carry_in = 0;
-        REQUIRE(m_bigint.add_carry(&carry_in, BUCKET_MAX_SIZE, 0) == BUCKET_MAX_SIZE);
-        REQUIRE(carry_in == 0);
+        BigInt* num = str_BigInt("0x123456789abcdef0123456789abcdef");
+        BigInt* copy = str_BigInt("0x123456789abcdef0123456789abcdef");
+        int used = buckets(num);
+
+        REQUIRE(reserve_capacity(num, 100) == num);
+        REQUIRE(buckets(num) == 100);
+        REQUIRE(reserve_capacity(num, 10) == num);
+        REQUIRE(buckets(num) == 100);
+        REQUIRE(compare_bigint(num, copy) == 0);
+
+        add_into(copy, num);
+        subtract_from(copy, num);
+        REQUIRE(buckets(num) == 100);
+        REQUIRE(shrink_to_fit(num) == num);
+        REQUIRE(buckets(num) == used);
+        REQUIRE(compare_bigint(num, copy) == 0);
+
+        REQUIRE(reserve_capacity(NULL, 4) == NULL);
+        REQUIRE(shrink_to_fit(NULL) == NULL);
+        free_BigInt(num);
+        free_BigInt(copy);
     }
-    SECTION("Carry in 0, add BUCKET_MAX + 1 returns 0, carry out 1")
+    SECTION("Small values move in and out of the inline buckets")
     {
-        carry_in = 0;
-        REQUIRE(m_bigint.add_carry(&carry_in, BUCKET_MAX_SIZE, 1) == 0);
-        REQUIRE(carry_in == 1);
+        BigInt* num = val_BigInt(3);
+        BigInt* three = val_BigInt(3);
+        BigInt* seven = val_BigInt(7);
+        for(int i = 0; i < 7; ++i)
+        {
+            square_into(num);
+        }
+
+        // 3^128 takes 203 bits, num - (3^128 - 7) leaves a single bucket
+        BigInt* power = pow_BigInt(three, 128);
+        REQUIRE(compare_bigint(num, power) == 0);
+        subtract_from(seven, power);
+        subtract_from(power, num);
+        REQUIRE(shrink_to_fit(num) == num);
+        REQUIRE(buckets(num) == 1);
+        REQUIRE(compare_uint(num, 7) == 0);
+
+        multiply_into(seven, num);
+        REQUIRE(compare_uint(num, 49) == 0);
+        free_BigInt(num);
+        free_BigInt(three);
+        free_BigInt(seven);
+        free_BigInt(power);
     }
-    SECTION("Carry in 1, add BUCKET_MAX + 0 returns 0, carry out 1")
+    SECTION("Shrinking a view moves it into its own copy")
     {
-        carry_in = 1;
-        REQUIRE(m_bigint.add_carry(&carry_in, BUCKET_MAX_SIZE, 0) == 0);
-        REQUIRE(carry_in == 1);
+        bucket_t values[] = { 5, 0, 0, 0 };
+        BigInt* view = view_BigInt(values, 4);
+        BigInt* one = val_BigInt(1);
+
+        REQUIRE(shrink_to_fit(view) == view);
+        REQUIRE(buckets(view) == 1);
+        add_into(one, view);
+        REQUIRE(compare_uint(view, 6) == 0);
+        REQUIRE(values[0] == 5);
+        free_BigInt(view);
+        free_BigInt(one);
     }
-    SECTION("Carry in 1, add BUCKET_MAX + 1 returns 1, carry out 1")
+}
+
+TEST_CASE("Adding and subtracting signed BigInts", "[add][subtract][add_into][subtract_from]")
+{
+    // Every sign combination of a long and a short operand, either order
+    const char* values[] = { "0x123456789abcdef0123456789abcdef0123456789",
+                             "-0x123456789abcdef0123456789abcdef0123456789",
+                             "0xfedcba98765432100", "-0xfedcba98765432100", "0" };
+    for(const char* lhs : values)
     {
-        carry_in = 1;
-        REQUIRE(m_bigint.add_carry(&carry_in, BUCKET_MAX_SIZE, 1) == 1);
-        REQUIRE(carry_in == 1);
+        for(const char* rhs : values)
+        {
+            BigInt* a = str_BigInt(lhs);
+            BigInt* b = str_BigInt(rhs);
+            BigInt* sum = add(a, b);
+            BigInt* difference = subtract(a, b);
+
+            // (a + b) - b == a and (a - b) + b == a, in place as well
+            BigInt* back = subtract(sum, b);
+            REQUIRE(compare_bigint(back, a) == 0);
+            REQUIRE(sign(back) == sign(a));
+            add_into(b, difference);
+            REQUIRE(compare_bigint(difference, a) == 0);
+            REQUIRE(sign(difference) == sign(a));
+            subtract_from(b, sum);
+            REQUIRE(compare_bigint(sum, a) == 0);
+            REQUIRE(sign(sum) == sign(a));
+
+            free_BigInt(a);
+            free_BigInt(b);
+            free_BigInt(sum);
+            free_BigInt(difference);
+            free_BigInt(back);
+        }
     }
-    SECTION("Carry in 0, add BUCKET_MAX/2 + BUCKET_MAX/2 returns 0, carry out 1")
+
+    SECTION("An operand may be combined with itself")
     {
-        carry_in = 0;
-        REQUIRE(m_bigint.add_carry(&carry_in, 1UL << (BUCKET_WIDTH - 1), 
-                                              1UL << (BUCKET_WIDTH - 1)) == 0);
-        REQUIRE(carry_in == 1);
+        BigInt* num = str_BigInt("-0x123456789abcdef0123456789abcdef0123456789");
+        BigInt* zero = subtract(num, num);
+        REQUIRE(compare_uint(zero, 0) == 0);
+        REQUIRE(sign(zero) > 0);
+        REQUIRE(sign(num) < 0);
+
+        add_into(num, num);
+        BigInt* expected = str_BigInt("-0x2468acf13579bde02468acf13579bde02468acf12");
+        REQUIRE(compare_bigint(num, expected) == 0);
+        REQUIRE(sign(num) < 0);
+        subtract_from(num, num);
+        REQUIRE(compare_uint(num, 0) == 0);
+        REQUIRE(sign(num) > 0);
+
+        free_BigInt(num);
+        free_BigInt(zero);
+        free_BigInt(expected);
     }
 }
 
-TEST_CASE("Adding BigInts to produce a new BigInt", "[add]")
+TEST_CASE("Fixed width integers", "[BigInt256][BigInt512][BigInt1024]")
 {
-    SECTION("add with b1 OR b2 as NULL returns NULL")
-    {
-        BigInt* placeholder = empty_BigInt();
-        REQUIRE(add(placeholder, NULL) == NULL);
-        REQUIRE(add(NULL, placeholder) == NULL);
-        free_BigInt(placeholder);
-    }
-    SECTION("Trivial addition")
-    {
-        BigInt* num1 = val_BigInt(1);
-        BigInt* num2 = str_BigInt("1");
+    const char* a_hex = "0xfedcba9876543210f0e1d2c3b4a5968778695a4b3c2d1e0f0123456789abcdef";
+    const char* b_hex = "0x8badf00ddeadbeefcafebabe0ddba11fee1deadc0ffee123456789abcdef0123";
+    BigInt* a = str_BigInt(a_hex);
+    BigInt* b = str_BigInt(b_hex);
+    BigInt256 x, y, z;
+    REQUIRE(to_BigInt256(&x, a) == 0);
+    REQUIRE(to_BigInt256(&y, b) == 0);
+
+    SECTION("Conversions round trip and reject what doesn't fit")
+    {
+        BigInt* back = from_BigInt256(&x);
+        REQUIRE(compare_bigint(back, a) == 0);
+
+        BigInt* wide = multiply(a, b);
+        BigInt* negative = str_BigInt("-0x1");
+        REQUIRE(to_BigInt256(&z, wide) == -1);
+        REQUIRE(to_BigInt256(&z, negative) == -1);
+        REQUIRE(to_BigInt256(NULL, a) == -1);
+        REQUIRE(from_BigInt256(NULL) == NULL);
+        free_BigInt(back);
+        free_BigInt(wide);
+        free_BigInt(negative);
+    }
+    SECTION("Arithmetic matches BigInt and wraps at the width")
+    {
+        // a + b and a * b overflow 256 bits, the low bits and carry remain
+        BigInt* sum = add(a, b);
+        BigInt* difference = subtract(a, b);
+        BigInt* product = multiply(a, b);
+        BigInt* modulus = str_BigInt(("0x1" + std::string(64, '0')).c_str());
+        BigInt* low_sum = mod(sum, modulus);
+        BigInt* low_product = mod(product, modulus);
+
+        REQUIRE(add_BigInt256(&z, &x, &y) == 1);
+        BigInt* result = from_BigInt256(&z);
+        REQUIRE(compare_bigint(result, low_sum) == 0);
+        free_BigInt(result);
 
-        BigInt* result = add(num1, num2);
-        REQUIRE(compare_uint(result, 2) == 0);
-        free_BigInt(num1);
-        free_BigInt(num2);
+        REQUIRE(subtract_BigInt256(&z, &x, &y) == 0);
+        result = from_BigInt256(&z);
+        REQUIRE(compare_bigint(result, difference) == 0);
         free_BigInt(result);
-    }
-    SECTION("Adding a negative results in subtraction")
-    {
-        BigInt* num1 = val_BigInt(0xff);
-        BigInt* num2 = str_BigInt("-0x0f");
+        REQUIRE(subtract_BigInt256(&z, &y, &x) == 1);
 
-        BigInt* result = add(num1, num2);
-        REQUIRE(compare_uint(result, 0xf0) == 0);
+        multiply_BigInt256(&z, &x, &y);
+        result = from_BigInt256(&z);
+        REQUIRE(compare_bigint(result, low_product) == 0);
+        free_BigInt(result);
 
-        free_BigInt(num1);
-        free_BigInt(num2);
+        BigInt512 full;
+        multiply_wide_BigInt256(&full, &x, &y);
+        result = from_BigInt512(&full);
+        REQUIRE(compare_bigint(result, product) == 0);
         free_BigInt(result);
-    }
+
+        // dest may alias the operands
+        multiply_BigInt256(&x, &x, &x);
+        BigInt* square_a = square(a);
+        BigInt* low_square = mod(square_a, modulus);
+        result = from_BigInt256(&x);
+        REQUIRE(compare_bigint(result, low_square) == 0);
+        free_BigInt(result);
+
+        free_BigInt(sum);
+        free_BigInt(difference);
+        free_BigInt(product);
+        free_BigInt(modulus);
+        free_BigInt(low_sum);
+        free_BigInt(low_product);
+        free_BigInt(square_a);
+        free_BigInt(low_square);
+    }
+    SECTION("Comparing looks at every bucket")
+    {
+        REQUIRE(compare_BigInt256(&x, &y) == 1);
+        REQUIRE(compare_BigInt256(&y, &x) == -1);
+        REQUIRE(compare_BigInt256(&x, &x) == 0);
+    }
+    SECTION("The wider types share the kernels")
+    {
+        BigInt512 p, q, r;
+        BigInt* product = multiply(a, b);
+        REQUIRE(to_BigInt512(&p, product) == 0);
+        REQUIRE(to_BigInt512(&q, a) == 0);
+        subtract_BigInt512(&r, &p, &q);
+        add_BigInt512(&r, &r, &q);
+        REQUIRE(compare_BigInt512(&r, &p) == 0);
+
+        BigInt1024 full;
+        BigInt* square_product = square(product);
+        multiply_wide_BigInt512(&full, &p, &p);
+        BigInt* result = from_BigInt1024(&full);
+        REQUIRE(compare_bigint(result, square_product) == 0);
+        free_BigInt(product);
+        free_BigInt(square_product);
+        free_BigInt(result);
+    }
+    free_BigInt(a);
+    free_BigInt(b);
+}
+
+static int live_allocations = 0;
+static int total_allocations = 0;
+
+void* counting_malloc(size_t size)
+{
+    ++live_allocations;
+    ++total_allocations;
+    return malloc(size);
+}
+
+void* counting_realloc(void* ptr, size_t size)
+{
+    live_allocations += (ptr == NULL);
+    ++total_allocations;
+    return realloc(ptr, size);
+}
+
+void counting_free(void* ptr)
+{
+    live_allocations -= (ptr != NULL);
+    free(ptr);
+}
+
+TEST_CASE("Allocating through the allocator hooks", "[BigInt_set_allocator][arena]")
+{
+    const char* hex = "0x123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef";
+
+    SECTION("Every allocation goes through the hooks")
+    {
+        BigInt_set_allocator(counting_malloc, counting_realloc, counting_free);
+        BigInt* num = str_BigInt(hex);
+        BigInt* product = multiply(num, num);
+        BigInt* quotient = divide(product, num);
+        add_into(num, quotient);
+        REQUIRE(live_allocations > 0);
+
+        free_BigInt(num);
+        free_BigInt(product);
+        free_BigInt(quotient);
+        REQUIRE(live_allocations == 0);
+
+        // A partial set restores the C library's functions
+        BigInt_set_allocator(counting_malloc, NULL, counting_free);
+        free_BigInt(val_BigInt(1));
+        REQUIRE(live_allocations == 0);
+    }
+    SECTION("Arena allocations are reclaimed by a reset")
+    {
+        BigInt_set_allocator(BigInt_arena_malloc, BigInt_arena_realloc, BigInt_arena_free);
+        BigInt* expected = NULL;
+        for(int round = 0; round < 3; ++round)
+        {
+            // Temporaries are never freed, the reset drops them all
+            BigInt* num = str_BigInt(hex);
+            BigInt* acc = val_BigInt(0);
+            for(int i = 0; i < 100; ++i)
+            {
+                add_into(multiply(num, num), acc);
+            }
+            BigInt* quotient = divide(acc, multiply(num, num));
+            REQUIRE(compare_uint(quotient, 100) == 0);
+
+            BigInt* big = pow_BigInt(num, 5000);
+            BigInt_set_allocator(NULL, NULL, NULL);
+            if(expected == NULL)
+            {
+                expected = pow_BigInt(num, 5000);
+            }
+            REQUIRE(compare_bigint(big, expected) == 0);
+            BigInt_set_allocator(BigInt_arena_malloc, BigInt_arena_realloc, BigInt_arena_free);
+            BigInt_arena_reset();
+        }
+        BigInt_set_allocator(NULL, NULL, NULL);
+        BigInt_arena_release();
+        free_BigInt(expected);
+    }
+    SECTION("Arena reallocation keeps the contents")
+    {
+        uint8_t* bytes = (uint8_t*) BigInt_arena_malloc(3);
+        bytes[0] = 1; bytes[1] = 2; bytes[2] = 3;
+        bytes = (uint8_t*) BigInt_arena_realloc(bytes, 4 << 20);
+        REQUIRE((bytes[0] == 1 && bytes[1] == 2 && bytes[2] == 3));
+        bytes = (uint8_t*) BigInt_arena_realloc(bytes, 2);
+        REQUIRE((bytes[0] == 1 && bytes[1] == 2));
+        BigInt_arena_free(bytes);
+        BigInt_arena_release();
+    }
+}
+
+TEST_CASE("Selecting the arithmetic kernels", "[BigInt_set_kernels]")
+{
+    const char* hex = "0xfedcba9876543210fedcba9876543210fedcba9876543210fedcba9876543210";
+    BigInt* base = str_BigInt(hex);
+    BigInt* num = pow_BigInt(base, 40);
+    BigInt* other = add(num, num);
+
+    // Runs of all ones and all zeros buckets carry and borrow across lanes
+    bucket_t runs[2][300];
+    for(size_t i = 0; i < 300; ++i)
+    {
+        runs[0][i] = (i % 11 < 6) ? BUCKET_MAX_SIZE : (bucket_t) i;
+        runs[1][i] = (i % 7 == 0) ? 1 : (i % 13 == 0) ? BUCKET_MAX_SIZE : 0;
+    }
+    BigInt* ones = view_BigInt(runs[0], 300);
+    BigInt* sparse = view_BigInt(runs[1], 300);
+
+    REQUIRE(BigInt_set_kernels(BIGINT_KERNELS_GENERIC) == 0);
+    REQUIRE(BigInt_get_kernels() == BIGINT_KERNELS_GENERIC);
+    BigInt* results[] = { multiply(num, other), square(num), add(num, other), 
+                          subtract(num, other), add(ones, sparse), 
+                          subtract(sparse, ones) };
+    const size_t count = sizeof(results) / sizeof(results[0]);
+
+    // Every set computes the same results as the generic one
+    for(int set = BIGINT_KERNELS_ADX; set <= BIGINT_KERNELS_AVX512; ++set)
+    {
+        if(BigInt_set_kernels(set) != 0)
+        {
+            REQUIRE(BigInt_get_kernels() != set);
+            continue;
+        }
+        REQUIRE(BigInt_get_kernels() == set);
+        BigInt* expected[] = { multiply(num, other), square(num), add(num, other), 
+                               subtract(num, other), add(ones, sparse), 
+                               subtract(sparse, ones) };
+        for(size_t i = 0; i < count; ++i)
+        {
+            REQUIRE(compare_bigint(expected[i], results[i]) == 0);
+            free_BigInt(expected[i]);
+        }
+    }
+    REQUIRE(BigInt_set_kernels(-1) == -1);
+    REQUIRE(BigInt_get_kernels() != BIGINT_KERNELS_AUTO);
+    REQUIRE(BigInt_set_kernels(BIGINT_KERNELS_AUTO) == 0);
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        free_BigInt(results[i]);
+    }
+    free_BigInt(base);
+    free_BigInt(num);
+    free_BigInt(other);
+    free_BigInt(ones);
+    free_BigInt(sparse);
+}
+
+TEST_CASE("Multiplying with worker threads", "[BigInt_set_threads]")
+{
+    const char* hex = "0xfedcba9876543210fedcba9876543210fedcba9876543210fedcba9876543210";
+    BigInt* base = str_BigInt(hex);
+
+    // Long enough for parallel Toom-Cook 3 on every platform and for parallel
+    // transforms
+    BigInt* toom = pow_BigInt(base, 1000);
+    BigInt* ntt = pow_BigInt(base, 6000);
+    BigInt* toom_other = add(toom, base);
+    BigInt* ntt_other = add(ntt, base);
+
+    REQUIRE(BigInt_get_threads() == 1);
+    BigInt* results[] = { multiply(toom, toom_other), square(toom),
+                          multiply(ntt, ntt_other), square(ntt),
+                          divide(ntt, toom_other) };
+    const size_t count = sizeof(results) / sizeof(results[0]);
+
+    REQUIRE(BigInt_set_threads(4) == 0);
+    REQUIRE(BigInt_get_threads() == 4);
+
+    // The threaded results are identical
+    BigInt* threaded[] = { multiply(toom, toom_other), square(toom),
+                           multiply(ntt, ntt_other), square(ntt),
+                           divide(ntt, toom_other) };
+    for(size_t i = 0; i < count; ++i)
+    {
+        REQUIRE(compare_bigint(threaded[i], results[i]) == 0);
+        free_BigInt(threaded[i]);
+    }
+
+    // The workers take their scratch from arenas of their own, rewound after
+    // every task
+    BigInt_set_allocator(BigInt_arena_malloc, BigInt_arena_realloc, BigInt_arena_free);
+    for(int round = 0; round < 3; ++round)
+    {
+        REQUIRE(compare_bigint(multiply(toom, toom_other), results[0]) == 0);
+        REQUIRE(compare_bigint(square(ntt), results[3]) == 0);
+        BigInt_arena_reset();
+    }
+    BigInt_arena_release();
+    BigInt_set_allocator(NULL, NULL, NULL);
+    for(size_t i = 0; i < count; ++i)
+    {
+        free_BigInt(results[i]);
+    }
+
+    REQUIRE(BigInt_set_threads(0) == 0);
+    REQUIRE(BigInt_get_threads() >= 1);
+    REQUIRE(BigInt_set_threads(1) == 0);
+    REQUIRE(BigInt_get_threads() == 1);
+
+    free_BigInt(base);
+    free_BigInt(toom);
+    free_BigInt(ntt);
+    free_BigInt(toom_other);
+    free_BigInt(ntt_other);
+}
+
+TEST_CASE("Batched arithmetic", "[add_batch][subtract_batch][multiply_batch][compare_batch]")
+{
+    const char* values[] = { "0x123456789abcdef0123456789abcdef0123456789",
+                             "-0x123456789abcdef0123456789abcdef0123456789",
+                             "0xfedcba98765432100", "-0xfedcba98765432100", "0", "-0x1" };
+    const size_t nvalues = sizeof(values) / sizeof(values[0]);
+    const size_t count = nvalues * nvalues;
+
+    // Every sign and length combination, written over a longer stale value
+    std::vector<BigInt*> b1, b2, dest;
+    for(size_t i = 0; i < count; ++i)
+    {
+        b1.push_back(str_BigInt(values[i / nvalues]));
+        b2.push_back(str_BigInt(values[i % nvalues]));
+        dest.push_back(str_BigInt("0xffffffffffffffffffffffffffffffffffffffffffffffffffffffff"));
+    }
+
+    SECTION("Every item matches the single operation")
+    {
+        std::vector<int> results(count);
+        REQUIRE(add_batch(dest.data(), b1.data(), b2.data(), count) == 0);
+        for(size_t i = 0; i < count; ++i)
+        {
+            BigInt* expected = add(b1[i], b2[i]);
+            REQUIRE(compare_bigint(dest[i], expected) == 0);
+            REQUIRE(sign(dest[i]) == sign(expected));
+            free_BigInt(expected);
+        }
+        REQUIRE(subtract_batch(dest.data(), b1.data(), b2.data(), count) == 0);
+        for(size_t i = 0; i < count; ++i)
+        {
+            BigInt* expected = subtract(b1[i], b2[i]);
+            REQUIRE(compare_bigint(dest[i], expected) == 0);
+            REQUIRE(sign(dest[i]) == sign(expected));
+            free_BigInt(expected);
+        }
+        REQUIRE(multiply_batch(dest.data(), b1.data(), b2.data(), count) == 0);
+        REQUIRE(compare_batch(results.data(), dest.data(), b1.data(), count) == 0);
+        for(size_t i = 0; i < count; ++i)
+        {
+            BigInt* expected = multiply(b1[i], b2[i]);
+            REQUIRE(compare_bigint(dest[i], expected) == 0);
+            REQUIRE(sign(dest[i]) == sign(expected));
+            REQUIRE(results[i] == compare_bigint(dest[i], b1[i]));
+            free_BigInt(expected);
+        }
+    }
+    SECTION("A dest may be one of its operands")
+    {
+        std::vector<BigInt*> expected;
+        for(size_t i = 0; i < count; ++i)
+        {
+            BigInt* product = multiply(b1[i], b2[i]);
+            expected.push_back(add(product, b1[i]));
+            free_BigInt(product);
+        }
+        REQUIRE(multiply_batch(b2.data(), b1.data(), b2.data(), count) == 0);
+        REQUIRE(add_batch(b2.data(), b2.data(), b1.data(), count) == 0);
+        for(size_t i = 0; i < count; ++i)
+        {
+            REQUIRE(compare_bigint(b2[i], expected[i]) == 0);
+            REQUIRE(sign(b2[i]) == sign(expected[i]));
+            free_BigInt(expected[i]);
+        }
+
+        // Squares
+        BigInt* square_expected = square(b1[0]);
+        REQUIRE(multiply_batch(b1.data(), b1.data(), b1.data(), 1) == 0);
+        REQUIRE(compare_bigint(b1[0], square_expected) == 0);
+        free_BigInt(square_expected);
+    }
+    SECTION("Long batches are split across threads")
+    {
+        std::vector<BigInt*> long1, long2, serial, threaded;
+        for(size_t i = 0; i < 4000; ++i)
+        {
+            long1.push_back(b1[i % count]);
+            long2.push_back(b2[(i / count) % count]);
+            serial.push_back(val_BigInt(0));
+            threaded.push_back(val_BigInt(0));
+        }
+        REQUIRE(multiply_batch(serial.data(), long1.data(), long2.data(), 4000) == 0);
+        REQUIRE(BigInt_set_threads(4) == 0);
+        REQUIRE(multiply_batch(threaded.data(), long1.data(), long2.data(), 4000) == 0);
+        REQUIRE(BigInt_set_threads(1) == 0);
+        size_t mismatches = 0;
+        for(size_t i = 0; i < 4000; ++i)
+        {
+            mismatches += compare_bigint(threaded[i], serial[i]) != 0 || 
+                          sign(threaded[i]) != sign(serial[i]);
+            free_BigInt(serial[i]);
+            free_BigInt(threaded[i]);
+        }
+        REQUIRE(mismatches == 0);
+    }
+    SECTION("NULL arguments are rejected")
+    {
+        BigInt* second = dest[1];
+        dest[1] = NULL;
+        REQUIRE(add_batch(dest.data(), b1.data(), b2.data(), count) == -1);
+        REQUIRE(add_batch(NULL, b1.data(), b2.data(), count) == -1);
+        REQUIRE(compare_batch(NULL, b1.data(), b2.data(), count) == -1);
+        REQUIRE(compare_batch(std::vector<int>(count).data(), dest.data(),
+                              b2.data(), count) == -1);
+        dest[1] = second;
+    }
+
+    for(size_t i = 0; i < count; ++i)
+    {
+        free_BigInt(b1[i]);
+        free_BigInt(b2[i]);
+        free_BigInt(dest[i]);
+    }
+}
+
+TEST_CASE("Determining sign of a BigInt", "[sign]")
+{
+    SECTION("Negative BigInt returns sign < 0")
+    {
+        BigInt* num = str_BigInt("-0xffff");
+        REQUIRE(sign(num) < 0);
+        free_BigInt(num);
+    }
+    SECTION("Positive BigInt returns sign > 0")
+    {
+        BigInt* num = str_BigInt("0xffff");
+        REQUIRE(sign(num) > 0);
+        free_BigInt(num);
+    }
+    SECTION("Empty BigInt returns sign > 0")
+    {
+        BigInt* num = empty_BigInt();
+        REQUIRE(sign(num) > 0);
+        free_BigInt(num);
+    }
+    SECTION("Passing NULL to sign() returns 0")
+    {
+        BigInt* num = NULL;
+        REQUIRE(sign(num) == 0);
+    }
+}
+
+TEST_CASE("Determining the number of hex_digits in a BigInt", "[hex_digits]")
+{
+    SECTION("Number of hexadecimal digits")
+    {
+        // 81985529216486895 DEC
+        BigInt* num = str_BigInt("0x123456789abcdef");
+        REQUIRE(hex_digits(num) == 15);
+        free_BigInt(num);
+    }
+    SECTION("Passing null to hex_digits return -1")
+    {
+        REQUIRE(hex_digits(NULL) == -1);
+    }
+    SECTION("Number of hex_digits on a zero valued bigint = 1")
+    {
+        BigInt* num = str_BigInt("0x000000000000000000");
+        REQUIRE(num != NULL);
+        REQUIRE(hex_digits(num) == 1);
+        free_BigInt(num);
+    }
+    SECTION("Digits follow a result that shrinks in place")
+    {
+        BigInt* num = str_BigInt("0x123456789abcdef0123456789abcdef");
+        BigInt* other = str_BigInt("0x123456789abcdef0123456789abcdee");
+        square_into(num);
+        multiply_into(other, other);
+        subtract_from(other, num);
+
+        // x^2 - (x - 1)^2 = 2x - 1 in buckets sized for the squares
+        REQUIRE(hex_digits(num) == 31);
+        REQUIRE(compare_uint(num, 1) > 0);
+        clear_BigInt(num);
+        REQUIRE(hex_digits(num) == 1);
+        REQUIRE(compare_uint(num, 0) == 0);
+        free_BigInt(num);
+        free_BigInt(other);
+    }
+}
+
+TEST_CASE("Comparing BigInts to unsigned values", "[compare_uint]")
+{
+    BigInt* num = str_BigInt("0x10000000000000000000000000000000000");
+    REQUIRE(compare_uint(num, 0) > 0);
+    REQUIRE(compare_uint(num, BUCKET_MAX_SIZE) > 0);
+    free_BigInt(num);
+
+    num = val_BigInt(7);
+    REQUIRE(compare_uint(num, 8) < 0);
+    REQUIRE(compare_uint(num, 7) == 0);
+    REQUIRE(compare_uint(num, 6) > 0);
+    free_BigInt(num);
+}
+
+#ifdef MOCKING_ENABLED
+
+TEST_CASE("Constructing BigInts with values > BUCKET_MAX_SIZE", "[constructors]")
+{
+    // To make these tests easier to write/debug most of them are written only 
+    // for the 8bit configuration, the final composite test tests all 
+    // configurations.
+    #ifdef BIGINT__8bit 
+    SECTION("Even number of digits")
+    {
+        const char* test_str = "0x1000";
+        BigInt* num = str_BigInt(test_str);
+
+        bucket_t* values = m_bigint.get_buckets(num);
+
+        REQUIRE(buckets(num) == 2);
+        REQUIRE(values[0] == 0);
+        REQUIRE(values[1] == 16);
+        free_BigInt(num);
+    }
+    SECTION("string with odd number of digits")
+    {
+        const char* test_str = "0x1234567";
+        bucket_t expected_values[] = { 103, 69, 35, 1 };
+
+        BigInt* num = str_BigInt(test_str);
+        bucket_t* values = m_bigint.get_buckets(num);
+
+        REQUIRE(buckets(num) == 4);
+        for(int i = 0; i < 4; ++i)
+        {
+            REQUIRE(expected_values[i] == values[i]);
+        }
+
+        free_BigInt(num);
+    }
+    SECTION("Leading zeroes are ignored")
+    {
+        const char* test_str = "0x000000100ff";
+        bucket_t expected_values[] = { 255, 0, 1 };
+
+        BigInt* num = str_BigInt(test_str);
+        bucket_t* values = m_bigint.get_buckets(num);
+
+        REQUIRE(buckets(num) == 3);
+        for(int i = 0; i < 3; ++i)
+        {
+            REQUIRE(expected_values[i] == values[i]);
+        }
+
+        free_BigInt(num);
+    }
+    SECTION("Large negative value")
+    {
+        const char* test_str = "-0x123456789abcdef";
+        bucket_t expected_values[] = { 239, 205, 171, 137, 103, 69, 35, 1 };
+
+        BigInt* num = str_BigInt(test_str);
+        bucket_t* values = m_bigint.get_buckets(num);
+
+        REQUIRE(buckets(num) == 8);
+        for(int i = 0; i < 8; ++i)
+        {
+            REQUIRE(expected_values[i] == values[i]);
+        }
+
+        free_BigInt(num);
+    }
+    #endif
+
+    SECTION("Composite Test")
+    {
+        const char* test_str = "\t\t  \n-001112233445566778899aabbccddeeff  \t";
+        #ifdef BIGINT__8bit
+        uint8_t expected_values[] = {
+            0xff, 0xee, 0xdd, 0xcc, 0xbb, 0xaa, 0x99, 0x88, 
+            0x77, 0x66, 0x55, 0x44, 0x33, 0x22, 0x11, 0x1
+        };
+        int nbuckets = 16;
+        #else
+        #ifdef BIGINT__x64
+        uint64_t expected_values[] = {
+            0x8899aabbccddeeff, 0x111223344556677
+        };
+        int nbuckets = 2;
+        #else // BIGINT__x86
+        uint32_t expected_values[] = {
+            0xccddeeff, 0x8899aabb, 0x44556677, 0x1112233
+        };
+        int nbuckets = 4;
+        #endif
+        #endif
+
+        BigInt* num = str_BigInt(test_str);
+        bucket_t* values = m_bigint.get_buckets(num);
+
+        REQUIRE(buckets(num) == nbuckets);
+        for(int i = 0; i < nbuckets; ++i)
+        {
+            REQUIRE(expected_values[i] == values[i]);
+        }
+        free_BigInt(num);
+    }
+}
+
+TEST_CASE("Adding with carry_in and carry_out", "[add_with_carry]")
+{
+    bucket_t carry_in = 1;
+
+    SECTION("Carry in 1, add 0 + 0 returns 1, carry_out 0")
+    {
+        int result = m_bigint.add_carry(&carry_in, 0, 0);
+        REQUIRE(result == 1);
+        REQUIRE(carry_in == 0);
+    }
+    SECTION("Carry in 0, add 0 + 0 returns 0, carry out 0")
+    {
+        carry_in = 0;
+        REQUIRE(m_bigint.add_carry(&carry_in, 0, 0) == 0);
+        REQUIRE(carry_in == 0);
+    }
+    SECTION("Carry in 0, add BUCKET_MAX_SIZE + 0 returns BUCKET_MAX_SIZE, carry out 0")
+    {
+        carry_in = 0;
+        REQUIRE(m_bigint.add_carry(&carry_in, BUCKET_MAX_SIZE, 0) == BUCKET_MAX_SIZE);
+        REQUIRE(carry_in == 0);
+    }
+    SECTION("Carry in 0, add BUCKET_MAX + 1 returns 0, carry out 1")
+    {
+        carry_in = 0;
+        REQUIRE(m_bigint.add_carry(&carry_in, BUCKET_MAX_SIZE, 1) == 0);
+        REQUIRE(carry_in == 1);
+    }
+    SECTION("Carry in 1, add BUCKET_MAX + 0 returns 0, carry out 1")
+    {
+        carry_in = 1;
+        REQUIRE(m_bigint.add_carry(&carry_in, BUCKET_MAX_SIZE, 0) == 0);
+        REQUIRE(carry_in == 1);
+    }
+    SECTION("Carry in 1, add BUCKET_MAX + 1 returns 1, carry out 1")
+    {
+        carry_in = 1;
+        REQUIRE(m_bigint.add_carry(&carry_in, BUCKET_MAX_SIZE, 1) == 1);
+        REQUIRE(carry_in == 1);
+    }
+    SECTION("Carry in 0, add BUCKET_MAX/2 + BUCKET_MAX/2 returns 0, carry out 1")
+    {
+        carry_in = 0;
+        REQUIRE(m_bigint.add_carry(&carry_in, 1UL << (BUCKET_WIDTH - 1), 
+                                              1UL << (BUCKET_WIDTH - 1)) == 0);
+        REQUIRE(carry_in == 1);
+    }
+}
+
+TEST_CASE("Adding BigInts to produce a new BigInt", "[add]")
+{
+    SECTION("add with b1 OR b2 as NULL returns NULL")
+    {
+        BigInt* placeholder = empty_BigInt();
+        REQUIRE(add(placeholder, NULL) == NULL);
+        REQUIRE(add(NULL, placeholder) == NULL);
+        free_BigInt(placeholder);
+    }
+    SECTION("Trivial addition")
+    {
+        BigInt* num1 = val_BigInt(1);
+        BigInt* num2 = str_BigInt("1");
+
+        BigInt* result = add(num1, num2);
+        REQUIRE(compare_uint(result, 2) == 0);
+        free_BigInt(num1);
+        free_BigInt(num2);
+        free_BigInt(result);
+    }
+    SECTION("Adding a negative results in subtraction")
+    {
+        BigInt* num1 = val_BigInt(0xff);
+        BigInt* num2 = str_BigInt("-0x0f");
+
+        BigInt* result = add(num1, num2);
+        REQUIRE(compare_uint(result, 0xf0) == 0);
+
+        free_BigInt(num1);
+        free_BigInt(num2);
+        free_BigInt(result);
+    }
+    SECTION("Adding a larger negative flips the sign")
+    {
+        BigInt* num1 = val_BigInt(0x0f);
+        BigInt* num2 = str_BigInt("-0xff");
+
+        BigInt* result = add(num1, num2);
+        REQUIRE(compare_uint(result, 240) == 0);
+        REQUIRE(sign(result) < 0);
+
+        free_BigInt(num1);
+        free_BigInt(num2);
+        free_BigInt(result);
+    }
+    SECTION("Adding a larger positive to a negative flips the sign")
+    {
+        BigInt* num1 = val_BigInt(0xff);
+        BigInt* num2 = str_BigInt("-0x0f");
+
+        BigInt* result = add(num2, num1);
+        REQUIRE(compare_uint(result, 240) == 0);
+        REQUIRE(sign(result) > 0);
+
+        free_BigInt(num1);
+        free_BigInt(num2);
+        free_BigInt(result);
+
+    }
+    SECTION("BUCKET_MAX + BUCKET_MAX returns 2 BUCKET_MAX")
+    {
+#if defined( BIGINT__x64 )
+        const char* bucket_max = "0xffffffffffffffff";
+        bucket_t expected_values[] = { 0xfffffffffffffffe, 0x1 };
+#elif defined( BIGINT__x86 )
+        const char* bucket_max = "0xffffffff";
+        bucket_t expected_values[] = { 0xfffffffe, 0x1 };
+#else // defined (BIGINT__8bit)
+        const char* bucket_max = "0xff";
+        bucket_t expected_values[] = { 0xfe, 0x1 };
+#endif
+        BigInt* num1 = str_BigInt(bucket_max);
+        BigInt* num2 = str_BigInt(bucket_max);
+        BigInt* num3 = add(num1, num2);
+
+        bucket_t* result = m_bigint.get_buckets(num3);
+
+        for (int i = 0; i < buckets(num3); ++i)
+        {
+            REQUIRE(result[i] == expected_values[i]);
+        }
+        free_BigInt(num1);
+        free_BigInt(num2);
+        free_BigInt(num3);
+    }
+#if defined ( BIGINT__8bit )
+    SECTION("Addition with BigInt's of varying length")
+    {
+        const char* bignum = "0xfffffffff";
+        const char* smallnum = "0xff";
+        bucket_t expected_values[] = { 0xfe, 0x00, 0x00, 0x00, 0x10 };
+
+        BigInt* num1 = str_BigInt(bignum);
+        BigInt* num2 = str_BigInt(smallnum);
+        BigInt* num3 = add(num1, num2);
+
+        bucket_t* result = m_bigint.get_buckets(num3);
+
+        for (int i = 0; i < 5; ++i)
+        {
+            REQUIRE((int) result[i] == expected_values[i]);
+        }
+        free_BigInt(num1);
+        free_BigInt(num2);
+        free_BigInt(num3);
+    }
+    SECTION("Fib sequence sample")
+    {
+        bucket_t expected_values[] = { 0x62, 0x2 };
+
+        BigInt* num1 = str_BigInt("0xe9");
+        BigInt* num2 = str_BigInt("0x179");
+        BigInt* num3 = add(num1, num2);
+
+        bucket_t* result = m_bigint.get_buckets(num3);
+
+        for (int i = 0; i < 2; ++i)
+        {
+            REQUIRE((int) result[i] == (int) expected_values[i]);
+        }
+        free_BigInt(num1);
+        free_BigInt(num2);
+        free_BigInt(num3);
+    }
+    SECTION("Fib sequence sample 2")
+    {
+        bucket_t expected_values[] = { 0x31, 0xda, 0x1 };
+
+        BigInt* num1 = str_BigInt("0xb520");
+        BigInt* num2 = str_BigInt("0x12511");
+        BigInt* num3 = add(num1, num2);
+
+        bucket_t* result = m_bigint.get_buckets(num3);
+
+        for (int i = 0; i < 3; ++i)
+        {
+            REQUIRE((int) result[i] == (int) expected_values[i]);
+        }
+        free_BigInt(num1);
+        free_BigInt(num2);
+        free_BigInt(num3);
+    }
+#endif
+}
+
+TEST_CASE("Adding BigInt into another BigInt", "[add_into]")
+{
+    SECTION("add with b1 OR b2 as NULL returns NULL")
+    {
+        BigInt* placeholder = empty_BigInt();
+        REQUIRE(add(placeholder, NULL) == NULL);
+        REQUIRE(add(NULL, placeholder) == NULL);
+        free_BigInt(placeholder);
+    }
+    SECTION("Trivial addition")
+    {
+        BigInt* num1 = val_BigInt(1);
+        BigInt* num2 = str_BigInt("1");
+
+        add_into(num1, num2);
+        REQUIRE(compare_uint(num2, 2) == 0);
+        free_BigInt(num1);
+        free_BigInt(num2);
+    }
+    SECTION("Adding a negative results in subtraction")
+    {
+        BigInt* num1 = val_BigInt(0xff);
+        BigInt* num2 = str_BigInt("-0x0f");
+
+        add_into(num1, num2);
+        REQUIRE(compare_uint(num2, 0xf0) == 0);
+
+        free_BigInt(num1);
+        free_BigInt(num2);
+    }
     SECTION("Adding a larger negative flips the sign")
     {
         BigInt* num1 = val_BigInt(0x0f);
-        BigInt* num2 = str_BigInt("-0xff");
+        BigInt* num2 = str_BigInt("-0xff");
+
+        BigInt* result = add(num1, num2);
+        REQUIRE(compare_uint(result, 240) == 0);
+        REQUIRE(sign(result) < 0);
+
+        free_BigInt(num1);
+        free_BigInt(num2);
+        free_BigInt(result);
+    }
+    SECTION("BUCKET_MAX + BUCKET_MAX returns 2 * BUCKET_MAX")
+    {
+#if defined( BIGINT__x64 )
+        const char* bucket_max = "0xffffffffffffffff";
+        bucket_t expected_values[] = { 0xfffffffffffffffe, 0x1 };
+#elif defined( BIGINT__x86 )
+        const char* bucket_max = "0xffffffff";
+        bucket_t expected_values[] = { 0xfffffffe, 0x1 };
+#else // defined (BIGINT__8bit)
+        const char* bucket_max = "0xff";
+        bucket_t expected_values[] = { 0xfe, 0x1 };
+#endif
+        BigInt* num1 = str_BigInt(bucket_max);
+        BigInt* num2 = str_BigInt(bucket_max);
+
+        add_into(num1, num2);
+
+        bucket_t* result = m_bigint.get_buckets(num2);
+
+        for (int i = 0; i < buckets(num2); ++i)
+        {
+            REQUIRE(result[i] == expected_values[i]);
+        }
+        free_BigInt(num1);
+        free_BigInt(num2);
+    }
+#if defined ( BIGINT__8bit )
+    SECTION("Addition with BigInt's of varying length")
+    {
+        const char* bignum = "0xfffffffff";
+        const char* smallnum = "0xff";
+        bucket_t expected_values[] = { 0xfe, 0x00, 0x00, 0x00, 0x10 };
+
+        BigInt* num1 = str_BigInt(bignum);
+        BigInt* num2 = str_BigInt(smallnum);
+
+        add_into(num1, num2);
+
+        bucket_t* result = m_bigint.get_buckets(num2);
+
+        for (int i = 0; i < 5; ++i)
+        {
+            REQUIRE((int) result[i] == (int) expected_values[i]);
+        }
+        free_BigInt(num1);
+        free_BigInt(num2);
+    }
+#endif
+}
+
+TEST_CASE("Subtracting BigInts", "[subtract]")
+{
+    SECTION("Trivial Subtraction")
+    {
+        BigInt* num1 = val_BigInt(5);
+        BigInt* num2 = val_BigInt(3);
+
+        BigInt* result = subtract(num1, num2);
+
+        REQUIRE(compare_uint(result, 2) == 0);
+
+        free_BigInt(num1);
+        free_BigInt(num2);
+        free_BigInt(result);
+    }
+    SECTION("subtracting a negative results in addition")
+    {
+        BigInt* num1 = val_BigInt(0xf0);
+        BigInt* num2 = str_BigInt("-0x0f");
+
+        BigInt* result = subtract(num1, num2);
+        REQUIRE(compare_uint(result, 0xff) == 0);
+
+        free_BigInt(num1);
+        free_BigInt(num2);
+        free_BigInt(result);
+    }
+    SECTION("Subtracting a larger number flips the sign")
+    {
+        BigInt* num1 = val_BigInt(0x0f);
+        BigInt* num2 = str_BigInt("0xff");
 
-        BigInt* result = add(num1, num2);
+        BigInt* result = subtract(num1, num2);
         REQUIRE(compare_uint(result, 240) == 0);
         REQUIRE(sign(result) < 0);
 
@@ -329,78 +1560,63 @@ TEST_CASE("Adding BigInts to produce a new BigInt", "[add]")
         free_BigInt(num2);
         free_BigInt(result);
     }
-    SECTION("Adding a larger positive to a negative flips the sign")
+    SECTION("Subtraction of two negatives")
     {
-        BigInt* num1 = val_BigInt(0xff);
-        BigInt* num2 = str_BigInt("-0x0f");
+        BigInt* num1 = str_BigInt("-0x0f");
+        BigInt* num2 = str_BigInt("-0xf0");
 
-        BigInt* result = add(num2, num1);
-        REQUIRE(compare_uint(result, 240) == 0);
+        BigInt* result = subtract(num1, num2);
+        REQUIRE(compare_uint(result, 225) == 0);
         REQUIRE(sign(result) > 0);
 
         free_BigInt(num1);
         free_BigInt(num2);
         free_BigInt(result);
-
     }
-    SECTION("BUCKET_MAX + BUCKET_MAX returns 2 BUCKET_MAX")
+    SECTION("-BUCKET_MAX - BUCKET_MAX returns 2BUCKET_MAX")
     {
 #if defined( BIGINT__x64 )
         const char* bucket_max = "0xffffffffffffffff";
+        const char* neg_bucket_max = "-0xffffffffffffffff";
         bucket_t expected_values[] = { 0xfffffffffffffffe, 0x1 };
 #elif defined( BIGINT__x86 )
         const char* bucket_max = "0xffffffff";
+        const char* neg_bucket_max = "-0xffffffff";
         bucket_t expected_values[] = { 0xfffffffe, 0x1 };
 #else // defined (BIGINT__8bit)
         const char* bucket_max = "0xff";
+        const char* neg_bucket_max = "-0xff";
         bucket_t expected_values[] = { 0xfe, 0x1 };
 #endif
-        BigInt* num1 = str_BigInt(bucket_max);
+        BigInt* num1 = str_BigInt(neg_bucket_max);
         BigInt* num2 = str_BigInt(bucket_max);
-        BigInt* num3 = add(num1, num2);
+        BigInt* num3 = subtract(num1, num2);
 
         bucket_t* result = m_bigint.get_buckets(num3);
 
+        REQUIRE(sign(num3) < 0);
         for (int i = 0; i < buckets(num3); ++i)
         {
-            REQUIRE(result[i] == expected_values[i]);
+            REQUIRE(result[i] == (uint64_t) expected_values[i]);
         }
         free_BigInt(num1);
         free_BigInt(num2);
         free_BigInt(num3);
     }
 #if defined ( BIGINT__8bit )
-    SECTION("Addition with BigInt's of varying length")
+    SECTION("subtraction with BigInt's of varying length")
     {
         const char* bignum = "0xfffffffff";
         const char* smallnum = "0xff";
-        bucket_t expected_values[] = { 0xfe, 0x00, 0x00, 0x00, 0x10 };
+        bucket_t expected_values[] = { 0x00, 0xff, 0xff, 0xff, 0xf };
 
         BigInt* num1 = str_BigInt(bignum);
         BigInt* num2 = str_BigInt(smallnum);
-        BigInt* num3 = add(num1, num2);
+        BigInt* num3 = subtract(num1, num2);
 
         bucket_t* result = m_bigint.get_buckets(num3);
 
         for (int i = 0; i < 5; ++i)
-        {
-            REQUIRE((int) result[i] == expected_values[i]);
-        }
-        free_BigInt(num1);
-        free_BigInt(num2);
-        free_BigInt(num3);
-    }
-    SECTION("Fib sequence sample")
-    {
-        bucket_t expected_values[] = { 0x62, 0x2 };
-
-        BigInt* num1 = str_BigInt("0xe9");
-        BigInt* num2 = str_BigInt("0x179");
-        BigInt* num3 = add(num1, num2);
-
-        bucket_t* result = m_bigint.get_buckets(num3);
-
-        for (int i = 0; i < 2; ++i)
         {
             REQUIRE((int) result[i] == (int) expected_values[i]);
         }
@@ -410,15 +1626,16 @@ TEST_CASE("Adding BigInts to produce a new BigInt", "[add]")
     }
     SECTION("Fib sequence sample 2")
     {
-        bucket_t expected_values[] = { 0x31, 0xda, 0x1 };
+        bucket_t expected_values[] = { 0xf1, 0x6f};
 
         BigInt* num1 = str_BigInt("0xb520");
         BigInt* num2 = str_BigInt("0x12511");
-        BigInt* num3 = add(num1, num2);
+        BigInt* num3 = subtract(num1, num2);
 
         bucket_t* result = m_bigint.get_buckets(num3);
 
-        for (int i = 0; i < 3; ++i)
+        REQUIRE(sign(num3) < 0);
+        for (int i = 0; i < 2; ++i)
         {
             REQUIRE((int) result[i] == (int) expected_values[i]);
         }
@@ -428,8 +1645,7 @@ TEST_CASE("Adding BigInts to produce a new BigInt", "[add]")
     }
 #endif
 }
-
-TEST_CASE("Adding BigInt into another BigInt", "[add_into]")
+TEST_CASE("Subtracting BigInt from another BigInt", "[subtract_from]")
 {
     SECTION("add with b1 OR b2 as NULL returns NULL")
     {
@@ -438,286 +1654,944 @@ TEST_CASE("Adding BigInt into another BigInt", "[add_into]")
         REQUIRE(add(NULL, placeholder) == NULL);
         free_BigInt(placeholder);
     }
-    SECTION("Trivial addition")
+    SECTION("Trivial subtraction")
     {
         BigInt* num1 = val_BigInt(1);
         BigInt* num2 = str_BigInt("1");
 
-        add_into(num1, num2);
-        REQUIRE(compare_uint(num2, 2) == 0);
+        subtract_from(num1, num2);
+        REQUIRE(compare_uint(num2, 0) == 0);
         free_BigInt(num1);
         free_BigInt(num2);
     }
-    SECTION("Adding a negative results in subtraction")
+    SECTION("Subtracting a negative results in addition")
     {
-        BigInt* num1 = val_BigInt(0xff);
+        BigInt* num1 = val_BigInt(0xf0);
         BigInt* num2 = str_BigInt("-0x0f");
 
-        add_into(num1, num2);
-        REQUIRE(compare_uint(num2, 0xf0) == 0);
+        subtract_from(num2, num1);
+        REQUIRE(compare_uint(num1, 0xff) == 0);
+
+        free_BigInt(num1);
+        free_BigInt(num2);
+    }
+    SECTION("Subtracting a larger negative flips the sign")
+    {
+        BigInt* num1 = val_BigInt(0xff);
+        BigInt* num2 = str_BigInt("0x0f");
+
+        subtract_from(num1, num2);
+        REQUIRE(compare_uint(num2, 240) == 0);
+        REQUIRE(sign(num2) < 0);
+
+        free_BigInt(num1);
+        free_BigInt(num2);
+    }
+    SECTION("-BUCKET_MAX - BUCKET_MAX returns 2BUCKET_MAX")
+    {
+#if defined( BIGINT__x64 )
+        const char* bucket_max = "0xffffffffffffffff";
+        const char* neg_bucket_max = "-0xffffffffffffffff";
+        bucket_t expected_values[] = { 0xfffffffffffffffe, 0x1 };
+#elif defined( BIGINT__x86 )
+        const char* bucket_max = "0xffffffff";
+        const char* neg_bucket_max = "-0xffffffff";
+        bucket_t expected_values[] = { 0xfffffffe, 0x1 };
+#else // defined (BIGINT__8bit)
+        const char* bucket_max = "0xff";
+        const char* neg_bucket_max = "-0xff";
+        bucket_t expected_values[] = { 0xfe, 0x1 };
+#endif
+        BigInt* num1 = str_BigInt(neg_bucket_max);
+        BigInt* num2 = str_BigInt(bucket_max);
+        
+        subtract_from(num2, num1);
+
+        bucket_t* result = m_bigint.get_buckets(num1);
+
+        REQUIRE(sign(num1) < 0);
+        for (int i = 0; i < buckets(num1); ++i)
+        {
+            REQUIRE(result[i] == (uint64_t) expected_values[i]);
+        }
+        free_BigInt(num1);
+        free_BigInt(num2);
+    }
+}
+
+TEST_CASE("Multiplying with carry_in and carry_out", "[mul_add_with_carry]")
+{
+    bucket_t carry = 0;
+
+    SECTION("Carry in 0, 2 * 3 + 0 returns 6, carry out 0")
+    {
+        REQUIRE(m_bigint.mul_add_carry(&carry, 2, 3, 0) == 6);
+        REQUIRE(carry == 0);
+    }
+    SECTION("Carry in 1, 2 * 3 + 1 returns 8, carry out 0")
+    {
+        carry = 1;
+        REQUIRE(m_bigint.mul_add_carry(&carry, 2, 3, 1) == 8);
+        REQUIRE(carry == 0);
+    }
+    SECTION("BUCKET_MAX * 2 returns BUCKET_MAX - 1, carry out 1")
+    {
+        REQUIRE(m_bigint.mul_add_carry(&carry, BUCKET_MAX_SIZE, 2, 0) 
+                == (bucket_t) (BUCKET_MAX_SIZE - 1));
+        REQUIRE(carry == 1);
+    }
+    SECTION("BUCKET_MAX * BUCKET_MAX + BUCKET_MAX + BUCKET_MAX doesn't overflow")
+    {
+        carry = BUCKET_MAX_SIZE;
+        REQUIRE(m_bigint.mul_add_carry(&carry, BUCKET_MAX_SIZE, BUCKET_MAX_SIZE, 
+                                       BUCKET_MAX_SIZE) == BUCKET_MAX_SIZE);
+        REQUIRE(carry == BUCKET_MAX_SIZE);
+    }
+}
+
+TEST_CASE("Multiplying BigInts", "[multiply]")
+{
+    SECTION("multiply with b1 OR b2 as NULL returns NULL")
+    {
+        BigInt* placeholder = empty_BigInt();
+        REQUIRE(multiply(placeholder, NULL) == NULL);
+        REQUIRE(multiply(NULL, placeholder) == NULL);
+        REQUIRE(multiply_into(placeholder, NULL) == NULL);
+        REQUIRE(multiply_into(NULL, placeholder) == NULL);
+        free_BigInt(placeholder);
+    }
+    SECTION("Trivial multiplication")
+    {
+        BigInt* num1 = val_BigInt(3);
+        BigInt* num2 = val_BigInt(5);
+
+        BigInt* result = multiply(num1, num2);
+        REQUIRE(compare_uint(result, 15) == 0);
+        REQUIRE(sign(result) > 0);
+
+        free_BigInt(num1);
+        free_BigInt(num2);
+        free_BigInt(result);
+    }
+    SECTION("Multiplying by a negative flips the sign")
+    {
+        BigInt* num1 = str_BigInt("-0x3");
+        BigInt* num2 = val_BigInt(5);
+        BigInt* num3 = str_BigInt("-0x5");
+
+        BigInt* result = multiply(num1, num2);
+        REQUIRE(compare_uint(result, 15) == 0);
+        REQUIRE(sign(result) < 0);
+        free_BigInt(result);
+
+        result = multiply(num1, num3);
+        REQUIRE(compare_uint(result, 15) == 0);
+        REQUIRE(sign(result) > 0);
+
+        free_BigInt(num1);
+        free_BigInt(num2);
+        free_BigInt(num3);
+        free_BigInt(result);
+    }
+    SECTION("Multiplying a negative by zero returns a positive zero")
+    {
+        BigInt* num1 = str_BigInt("-0xff");
+        BigInt* num2 = empty_BigInt();
+
+        BigInt* result = multiply(num1, num2);
+        REQUIRE(compare_uint(result, 0) == 0);
+        REQUIRE(sign(result) > 0);
+
+        free_BigInt(num1);
+        free_BigInt(num2);
+        free_BigInt(result);
+    }
+    SECTION("BUCKET_MAX * BUCKET_MAX returns (BUCKET_MAX - 1, 1)")
+    {
+        bucket_t expected_values[] = { 1, BUCKET_MAX_SIZE - 1 };
+
+        BigInt* num1 = val_BigInt(BUCKET_MAX_SIZE);
+        BigInt* result = multiply(num1, num1);
+
+        bucket_t* values = m_bigint.get_buckets(result);
+
+        REQUIRE(buckets(result) == 2);
+        for (int i = 0; i < 2; ++i)
+        {
+            REQUIRE(values[i] == expected_values[i]);
+        }
+        free_BigInt(num1);
+        free_BigInt(result);
+    }
+    SECTION("Multiplication of multi-bucket values")
+    {
+        BigInt* num1 = str_BigInt("0x123456789abcdef0123456789abcdef");
+        BigInt* num2 = str_BigInt("-0xfedcba9876543210fedcba98");
+        BigInt* expected = str_BigInt(
+            "0x121fa00ad77d742247acc913fca99aad05ebe789252c268ad05ebe8");
+
+        BigInt* result = multiply(num1, num2);
+        REQUIRE(compare_bigint(result, expected) == 0);
+        REQUIRE(sign(result) < 0);
+
+        free_BigInt(num1);
+        free_BigInt(num2);
+        free_BigInt(expected);
+        free_BigInt(result);
+    }
+    SECTION("Multiplying into an existing BigInt")
+    {
+        BigInt* num1 = str_BigInt("0x123456789abcdef0123456789abcdef");
+        BigInt* num2 = str_BigInt("0xfedcba9876543210fedcba98");
+        BigInt* expected = str_BigInt(
+            "0x121fa00ad77d742247acc913fca99aad05ebe789252c268ad05ebe8");
+
+        REQUIRE(multiply_into(num1, num2) == num2);
+        REQUIRE(compare_bigint(num2, expected) == 0);
 
         free_BigInt(num1);
         free_BigInt(num2);
+        free_BigInt(expected);
+    }
+}
+
+TEST_CASE("Multiplying BigInts above the multiplication thresholds", "[multiply]")
+{
+    SECTION("Balanced operands at every algorithm tier")
+    {
+        int sizes[] = { KARATSUBA_THRESHOLD - 1, KARATSUBA_THRESHOLD + 7, 
+                        TOOM3_THRESHOLD + 1, 3 * TOOM3_THRESHOLD + 2, 
+                        NTT_THRESHOLD + 3 };
+        for (int n : sizes)
+        {
+            BigInt* num1 = all_ones(n);
+            BigInt* num2 = all_ones(n);
+            BigInt* result = multiply(num1, num2);
+
+            REQUIRE(is_expected_product(result, n, n));
+
+            free_BigInt(num1);
+            free_BigInt(num2);
+            free_BigInt(result);
+        }
+    }
+    SECTION("Unbalanced operands")
+    {
+        int sizes[][2] = { { 5 * KARATSUBA_THRESHOLD + 3, KARATSUBA_THRESHOLD + 1 }, 
+                           { 2 * TOOM3_THRESHOLD, TOOM3_THRESHOLD + 5 },
+                           { 4 * TOOM3_THRESHOLD + 1, 3 * TOOM3_THRESHOLD },
+                           { 3 * NTT_THRESHOLD, NTT_THRESHOLD + 1 } };
+        for (auto& size : sizes)
+        {
+            BigInt* num1 = all_ones(size[0]);
+            BigInt* num2 = all_ones(size[1]);
+
+            BigInt* result = multiply(num2, num1);
+            REQUIRE(is_expected_product(result, size[0], size[1]));
+
+            multiply_into(num1, num2);
+            REQUIRE(is_expected_product(num2, size[0], size[1]));
+
+            free_BigInt(num1);
+            free_BigInt(num2);
+            free_BigInt(result);
+        }
+    }
+    SECTION("Views of different lengths over the same buckets")
+    {
+        size_t sizes[][2] = { { KARATSUBA_THRESHOLD + 28, KARATSUBA_THRESHOLD + 8 },
+                              { 3 * TOOM3_THRESHOLD + 16, 2 * TOOM3_THRESHOLD + 44 } };
+        for (auto& size : sizes)
+        {
+            std::vector<bucket_t> buckets(size[0]);
+            for (size_t i = 0; i < size[0]; ++i)
+            {
+                buckets[i] = (bucket_t) (i * 0x9e3779b97f4a7c15ULL) | 1;
+            }
+            std::vector<bucket_t> copy(buckets);
+
+            // The shared array must not be taken for a square
+            BigInt* longer = view_BigInt(buckets.data(), size[0]);
+            BigInt* shorter = view_BigInt(buckets.data(), size[1]);
+            BigInt* separate = view_BigInt(copy.data(), size[1]);
+            BigInt* result = multiply(longer, shorter);
+            BigInt* expected = multiply(longer, separate);
+
+            REQUIRE(compare_bigint(result, expected) == 0);
+
+            free_BigInt(longer);
+            free_BigInt(shorter);
+            free_BigInt(separate);
+            free_BigInt(result);
+            free_BigInt(expected);
+        }
+    }
+}
+
+TEST_CASE("Squaring BigInts", "[square]")
+{
+    SECTION("square with NULL returns NULL")
+    {
+        REQUIRE(square(NULL) == NULL);
+        REQUIRE(square_into(NULL) == NULL);
+    }
+    SECTION("Squaring a negative returns a positive")
+    {
+        BigInt* num = str_BigInt("-0xc");
+        BigInt* result = square(num);
+
+        REQUIRE(compare_uint(result, 144) == 0);
+        REQUIRE(sign(result) > 0);
+
+        REQUIRE(square_into(num) == num);
+        REQUIRE(compare_uint(num, 144) == 0);
+        REQUIRE(sign(num) > 0);
+
+        free_BigInt(num);
+        free_BigInt(result);
+    }
+    SECTION("Squaring multi-bucket values")
+    {
+        BigInt* num = str_BigInt("0x123456789abcdef0123456789abcdef");
+        BigInt* expected = str_BigInt(
+            "0x14b66dc33f6acdca878d6495a927ab94d0f77fe1940eedca5e20890f2a521");
+
+        BigInt* product = multiply(num, num);
+        BigInt* result = square(num);
+        REQUIRE(compare_bigint(result, product) == 0);
+        REQUIRE(compare_bigint(result, expected) == 0);
+
+        free_BigInt(num);
+        free_BigInt(expected);
+        free_BigInt(product);
+        free_BigInt(result);
+    }
+    SECTION("Squaring at every algorithm tier")
+    {
+        int sizes[] = { KARATSUBA_SQR_THRESHOLD - 1, KARATSUBA_SQR_THRESHOLD + 5, 
+                        TOOM3_THRESHOLD + 2, 3 * TOOM3_THRESHOLD + 1, 
+                        NTT_THRESHOLD + 1 };
+        for (int n : sizes)
+        {
+            BigInt* num = all_ones(n);
+            BigInt* result = square(num);
+
+            REQUIRE(is_expected_product(result, n, n));
+
+            square_into(num);
+            REQUIRE(is_expected_product(num, n, n));
+
+            free_BigInt(num);
+            free_BigInt(result);
+        }
+    }
+}
+
+TEST_CASE("Raising BigInts to a power", "[pow_BigInt]")
+{
+    SECTION("pow_BigInt with NULL returns NULL")
+    {
+        REQUIRE(pow_BigInt(NULL, 3) == NULL);
     }
-    SECTION("Adding a larger negative flips the sign")
+    SECTION("Trivial powers")
     {
-        BigInt* num1 = val_BigInt(0x0f);
-        BigInt* num2 = str_BigInt("-0xff");
+        BigInt* zero = empty_BigInt();
+        BigInt* one = val_BigInt(1);
+        BigInt* num = str_BigInt("-0x123456789abcdef");
 
-        BigInt* result = add(num1, num2);
-        REQUIRE(compare_uint(result, 240) == 0);
-        REQUIRE(sign(result) < 0);
+        BigInt* result = pow_BigInt(zero, 0);
+        REQUIRE(compare_uint(result, 1) == 0);
+        free_BigInt(result);
 
-        free_BigInt(num1);
-        free_BigInt(num2);
+        result = pow_BigInt(zero, 5);
+        REQUIRE(compare_uint(result, 0) == 0);
+        REQUIRE(sign(result) > 0);
         free_BigInt(result);
-    }
-    SECTION("BUCKET_MAX + BUCKET_MAX returns 2 * BUCKET_MAX")
-    {
-#if defined( BIGINT__x64 )
-        const char* bucket_max = "0xffffffffffffffff";
-        bucket_t expected_values[] = { 0xfffffffffffffffe, 0x1 };
-#elif defined( BIGINT__x86 )
-        const char* bucket_max = "0xffffffff";
-        bucket_t expected_values[] = { 0xfffffffe, 0x1 };
-#else // defined (BIGINT__8bit)
-        const char* bucket_max = "0xff";
-        bucket_t expected_values[] = { 0xfe, 0x1 };
-#endif
-        BigInt* num1 = str_BigInt(bucket_max);
-        BigInt* num2 = str_BigInt(bucket_max);
 
-        add_into(num1, num2);
+        result = pow_BigInt(one, 1000000);
+        REQUIRE(compare_uint(result, 1) == 0);
+        free_BigInt(result);
 
-        bucket_t* result = m_bigint.get_buckets(num2);
+        result = pow_BigInt(num, 1);
+        REQUIRE(compare_bigint(result, num) == 0);
+        REQUIRE(sign(result) < 0);
+        free_BigInt(result);
 
-        for (int i = 0; i < buckets(num2); ++i)
+        free_BigInt(zero);
+        free_BigInt(one);
+        free_BigInt(num);
+    }
+    SECTION("Powers of multi-bucket values")
+    {
+        const char* cases[][3] = { 
+            { "0x3", "40", "0xa8b8b452291fe821" },
+            { "0x3", "100", "0x5a4653ca673768565b41f775d6947d55cf3813d1" },
+            { "-0x123456789abcdef", "7", 
+              "-0x277e41183ca32cad9fc783c90beafe275ec1272f2067b0e5fe5ed5a33f6a23288aebffb5e3230acb1e2ccd94980fae41c8f" } };
+        for (auto& c : cases)
         {
-            REQUIRE(result[i] == expected_values[i]);
+            BigInt* base = str_BigInt(c[0]);
+            BigInt* expected = str_BigInt(c[2]);
+            BigInt* result = pow_BigInt(base, std::stoull(c[1]));
+
+            REQUIRE(compare_bigint(result, expected) == 0);
+            REQUIRE(sign(result) == sign(expected));
+
+            free_BigInt(base);
+            free_BigInt(expected);
+            free_BigInt(result);
         }
-        free_BigInt(num1);
-        free_BigInt(num2);
     }
-#if defined ( BIGINT__8bit )
-    SECTION("Addition with BigInt's of varying length")
+    SECTION("Powers of two are shifted into place")
     {
-        const char* bignum = "0xfffffffff";
-        const char* smallnum = "0xff";
-        bucket_t expected_values[] = { 0xfe, 0x00, 0x00, 0x00, 0x10 };
+        BigInt* base = str_BigInt("-0x10");
+        BigInt* result = pow_BigInt(base, 35);
 
-        BigInt* num1 = str_BigInt(bignum);
-        BigInt* num2 = str_BigInt(smallnum);
+        bucket_t* values = m_bigint.get_buckets(result);
+        int bucket = 4 * 35 / BUCKET_WIDTH;
 
-        add_into(num1, num2);
+        REQUIRE(buckets(result) == bucket + 1);
+        REQUIRE(values[bucket] == (bucket_t) 1 << (4 * 35 % BUCKET_WIDTH));
+        REQUIRE(sign(result) < 0);
 
-        bucket_t* result = m_bigint.get_buckets(num2);
+        free_BigInt(base);
+        free_BigInt(result);
+    }
+    SECTION("Squaring through the multiplication tiers")
+    {
+        int n = TOOM3_THRESHOLD + 3;
+        BigInt* base = all_ones(n);
+        BigInt* squared = square(base);
+        BigInt* result = pow_BigInt(base, 2);
 
-        for (int i = 0; i < 5; ++i)
-        {
-            REQUIRE((int) result[i] == (int) expected_values[i]);
-        }
-        free_BigInt(num1);
-        free_BigInt(num2);
+        REQUIRE(is_expected_product(squared, n, n));
+        REQUIRE(compare_bigint(result, squared) == 0);
+
+        BigInt* cube = multiply(squared, base);
+        free_BigInt(result);
+        result = pow_BigInt(base, 3);
+        REQUIRE(compare_bigint(result, cube) == 0);
+
+        free_BigInt(base);
+        free_BigInt(squared);
+        free_BigInt(cube);
+        free_BigInt(result);
     }
-#endif
 }
 
-TEST_CASE("Subtracting BigInts", "[subtract]")
+TEST_CASE("Dividing BigInts", "[divmod]")
 {
-    SECTION("Trivial Subtraction")
+    SECTION("divmod with NULL operands or a zero divisor fails")
     {
-        BigInt* num1 = val_BigInt(5);
-        BigInt* num2 = val_BigInt(3);
+        BigInt* num = val_BigInt(17);
+        BigInt* zero = empty_BigInt();
+        BigInt* q = NULL;
+        BigInt* r = NULL;
 
-        BigInt* result = subtract(num1, num2);
+        REQUIRE(divmod(NULL, num, &q, &r) == -1);
+        REQUIRE(divmod(num, NULL, &q, &r) == -1);
+        REQUIRE(divmod(num, zero, &q, &r) == -1);
+        REQUIRE(q == NULL);
+        REQUIRE(r == NULL);
+        REQUIRE(divide(num, zero) == NULL);
+        REQUIRE(mod(num, zero) == NULL);
 
-        REQUIRE(compare_uint(result, 2) == 0);
+        free_BigInt(num);
+        free_BigInt(zero);
+    }
+    SECTION("Trivial division")
+    {
+        BigInt* num1 = val_BigInt(17);
+        BigInt* num2 = val_BigInt(5);
+        BigInt* q = NULL;
+        BigInt* r = NULL;
+
+        REQUIRE(divmod(num1, num2, &q, &r) == 0);
+        REQUIRE(compare_uint(q, 3) == 0);
+        REQUIRE(compare_uint(r, 2) == 0);
 
         free_BigInt(num1);
         free_BigInt(num2);
-        free_BigInt(result);
+        free_BigInt(q);
+        free_BigInt(r);
     }
-    SECTION("subtracting a negative results in addition")
+    SECTION("The quotient truncates and the remainder takes the dividend's sign")
     {
-        BigInt* num1 = val_BigInt(0xf0);
-        BigInt* num2 = str_BigInt("-0x0f");
+        const char* operands[][2] = { { "-0x11", "0x5" }, { "0x11", "-0x5" }, 
+                                      { "-0x11", "-0x5" } };
+        int signs[][2] = { { -1, -1 }, { -1, 1 }, { 1, -1 } };
+        for (int i = 0; i < 3; ++i)
+        {
+            BigInt* num1 = str_BigInt(operands[i][0]);
+            BigInt* num2 = str_BigInt(operands[i][1]);
+            BigInt* q = divide(num1, num2);
+            BigInt* r = mod(num1, num2);
+
+            REQUIRE(compare_uint(q, 3) == 0);
+            REQUIRE(compare_uint(r, 2) == 0);
+            REQUIRE(sign(q) == signs[i][0]);
+            REQUIRE(sign(r) == signs[i][1]);
+
+            free_BigInt(num1);
+            free_BigInt(num2);
+            free_BigInt(q);
+            free_BigInt(r);
+        }
+    }
+    SECTION("A dividend smaller than the divisor is the remainder")
+    {
+        BigInt* num1 = str_BigInt("-0xfedcba9876543210");
+        BigInt* num2 = str_BigInt("0x123456789abcdef0123456789abcdef");
+        BigInt* q = NULL;
+        BigInt* r = NULL;
 
-        BigInt* result = subtract(num1, num2);
-        REQUIRE(compare_uint(result, 0xff) == 0);
+        REQUIRE(divmod(num1, num2, &q, &r) == 0);
+        REQUIRE(compare_uint(q, 0) == 0);
+        REQUIRE(sign(q) > 0);
+        REQUIRE(compare_bigint(r, num1) == 0);
+        REQUIRE(sign(r) < 0);
 
         free_BigInt(num1);
         free_BigInt(num2);
-        free_BigInt(result);
+        free_BigInt(q);
+        free_BigInt(r);
     }
-    SECTION("Subtracting a larger number flips the sign")
+    SECTION("Dividing by a single bucket divisor")
     {
-        BigInt* num1 = val_BigInt(0x0f);
-        BigInt* num2 = str_BigInt("0xff");
+        BigInt* num1 = str_BigInt("0x100000000000000000000000000000000000000000000000000");
+        BigInt* num2 = str_BigInt("0xfedcba9");
+        BigInt* expected_q = str_BigInt("0x101249251ae4924dadbb6ddd694b6efe914a54061c1c");
+        BigInt* expected_r = str_BigInt("0x5c13d84");
+        BigInt* q = NULL;
+        BigInt* r = NULL;
 
-        BigInt* result = subtract(num1, num2);
-        REQUIRE(compare_uint(result, 240) == 0);
-        REQUIRE(sign(result) < 0);
+        REQUIRE(divmod(num1, num2, &q, &r) == 0);
+        REQUIRE(compare_bigint(q, expected_q) == 0);
+        REQUIRE(compare_bigint(r, expected_r) == 0);
 
         free_BigInt(num1);
         free_BigInt(num2);
-        free_BigInt(result);
+        free_BigInt(expected_q);
+        free_BigInt(expected_r);
+        free_BigInt(q);
+        free_BigInt(r);
     }
-    SECTION("Subtraction of two negatives")
+    SECTION("Division of multi-bucket values")
     {
-        BigInt* num1 = str_BigInt("-0x0f");
-        BigInt* num2 = str_BigInt("-0xf0");
+        BigInt* num1 = str_BigInt(
+            "0x121fa00ad77d742247acc913fca99aad05ebe789252c268adb1b9d7");
+        BigInt* num2 = str_BigInt("0xfedcba9876543210fedcba98");
+        BigInt* expected_q = str_BigInt("0x123456789abcdef0123456789abcdef");
+        BigInt* expected_r = str_BigInt("0xabcdef");
+        BigInt* q = NULL;
+        BigInt* r = NULL;
 
-        BigInt* result = subtract(num1, num2);
-        REQUIRE(compare_uint(result, 225) == 0);
-        REQUIRE(sign(result) > 0);
+        REQUIRE(divmod(num1, num2, &q, &r) == 0);
+        REQUIRE(compare_bigint(q, expected_q) == 0);
+        REQUIRE(compare_bigint(r, expected_r) == 0);
 
         free_BigInt(num1);
         free_BigInt(num2);
-        free_BigInt(result);
+        free_BigInt(expected_q);
+        free_BigInt(expected_r);
+        free_BigInt(q);
+        free_BigInt(r);
     }
-    SECTION("-BUCKET_MAX - BUCKET_MAX returns 2BUCKET_MAX")
+    SECTION("Dividing a product by one of its factors")
     {
-#if defined( BIGINT__x64 )
-        const char* bucket_max = "0xffffffffffffffff";
-        const char* neg_bucket_max = "-0xffffffffffffffff";
-        bucket_t expected_values[] = { 0xfffffffffffffffe, 0x1 };
-#elif defined( BIGINT__x86 )
-        const char* bucket_max = "0xffffffff";
-        const char* neg_bucket_max = "-0xffffffff";
-        bucket_t expected_values[] = { 0xfffffffe, 0x1 };
-#else // defined (BIGINT__8bit)
-        const char* bucket_max = "0xff";
-        const char* neg_bucket_max = "-0xff";
-        bucket_t expected_values[] = { 0xfe, 0x1 };
-#endif
-        BigInt* num1 = str_BigInt(neg_bucket_max);
-        BigInt* num2 = str_BigInt(bucket_max);
-        BigInt* num3 = subtract(num1, num2);
-
-        bucket_t* result = m_bigint.get_buckets(num3);
+        int sizes[][2] = { { 1, 1 }, { 7, 3 }, { 40, 2 }, { 64, 64 }, { 150, 70 } };
+        for (auto& size : sizes)
+        {
+            BigInt* num1 = all_ones(size[0]);
+            BigInt* num2 = all_ones(size[1]);
+            BigInt* product = multiply(num1, num2);
+            BigInt* q = NULL;
+            BigInt* r = NULL;
+
+            REQUIRE(divmod(product, num2, &q, &r) == 0);
+            REQUIRE(compare_bigint(q, num1) == 0);
+            REQUIRE(compare_uint(r, 0) == 0);
+
+            free_BigInt(num1);
+            free_BigInt(num2);
+            free_BigInt(product);
+            free_BigInt(q);
+            free_BigInt(r);
+        }
+    }
+}
 
-        REQUIRE(sign(num3) < 0);
-        for (int i = 0; i < buckets(num3); ++i)
+TEST_CASE("Dividing BigInts above the Newton division threshold", "[divmod]")
+{
+    SECTION("Dividing a product by one of its factors")
+    {
+        int sizes[][2] = { { NEWTON_DIV_THRESHOLD + 3, NEWTON_DIV_THRESHOLD / 2 + 1 }, 
+                           { 2 * NEWTON_DIV_THRESHOLD, NEWTON_DIV_THRESHOLD + 7 },
+                           { NEWTON_DIV_THRESHOLD + 1, 3 * NEWTON_DIV_THRESHOLD } };
+        for (auto& size : sizes)
         {
-            REQUIRE(result[i] == (uint64_t) expected_values[i]);
+            BigInt* num1 = all_ones(size[0]);
+            BigInt* num2 = all_ones(size[1]);
+            BigInt* product = multiply(num1, num2);
+            BigInt* one = val_BigInt(1);
+            BigInt* q = NULL;
+            BigInt* r = NULL;
+
+            REQUIRE(divmod(product, num2, &q, &r) == 0);
+            REQUIRE(compare_bigint(q, num1) == 0);
+            REQUIRE(compare_uint(r, 0) == 0);
+            free_BigInt(q);
+            free_BigInt(r);
+
+            // (B^n - 1) * (B^m - 1) - 1 leaves a remainder of B^m - 2
+            BigInt* dividend = subtract(product, one);
+            BigInt* expected_q = subtract(num1, one);
+            BigInt* expected_r = subtract(num2, one);
+
+            REQUIRE(divmod(dividend, num2, &q, &r) == 0);
+            REQUIRE(compare_bigint(q, expected_q) == 0);
+            REQUIRE(compare_bigint(r, expected_r) == 0);
+
+            free_BigInt(num1);
+            free_BigInt(num2);
+            free_BigInt(product);
+            free_BigInt(one);
+            free_BigInt(dividend);
+            free_BigInt(expected_q);
+            free_BigInt(expected_r);
+            free_BigInt(q);
+            free_BigInt(r);
         }
-        free_BigInt(num1);
-        free_BigInt(num2);
-        free_BigInt(num3);
     }
-#if defined ( BIGINT__8bit )
-    SECTION("subtraction with BigInt's of varying length")
+}
+
+TEST_CASE("Montgomery modular multiplication", "[mont]")
+{
+    SECTION("new_mont_ctx with a NULL or even modulus returns NULL")
     {
-        const char* bignum = "0xfffffffff";
-        const char* smallnum = "0xff";
-        bucket_t expected_values[] = { 0x00, 0xff, 0xff, 0xff, 0xf };
+        BigInt* even = str_BigInt("0x123456789abcdef0123456789abcdef0");
+        REQUIRE(new_mont_ctx(NULL) == NULL);
+        REQUIRE(new_mont_ctx(even) == NULL);
+        REQUIRE(mont_buckets(NULL) == 0);
 
-        BigInt* num1 = str_BigInt(bignum);
-        BigInt* num2 = str_BigInt(smallnum);
-        BigInt* num3 = subtract(num1, num2);
+        bucket_t value = 1;
+        REQUIRE(mont_mul(NULL, &value, &value, &value) == NULL);
+        REQUIRE(mont_sqr(NULL, &value, &value) == NULL);
+        REQUIRE(to_mont(NULL, &value, &value) == NULL);
+        REQUIRE(from_mont(NULL, &value, &value) == NULL);
 
-        bucket_t* result = m_bigint.get_buckets(num3);
+        free_BigInt(even);
+    }
+    SECTION("Converting into and out of Montgomery form is lossless")
+    {
+        BigInt* modulus = str_BigInt("0xc3a5c85c97cb3127b5fd2a8d2f8b2a6d");
+        BigInt* num = str_BigInt("0x7f1e2d3c4b5a69788796a5b4c3d2e1f0");
+        BigIntMontCtx* ctx = new_mont_ctx(modulus);
+        int n = mont_buckets(ctx);
 
-        for (int i = 0; i < 5; ++i)
+        REQUIRE(n == buckets(modulus));
+
+        std::vector<bucket_t> values = to_buckets(num, n);
+        std::vector<bucket_t> original = values;
+
+        REQUIRE(to_mont(ctx, values.data(), values.data()) == values.data());
+        REQUIRE(values != original);
+        REQUIRE(from_mont(ctx, values.data(), values.data()) == values.data());
+        REQUIRE(values == original);
+
+        free_mont_ctx(ctx);
+        free_BigInt(modulus);
+        free_BigInt(num);
+    }
+    SECTION("Montgomery products match multiply and mod")
+    {
+        int sizes[] = { 1, 3, KARATSUBA_THRESHOLD + 1, TOOM3_THRESHOLD + 2 };
+        for (int n : sizes)
         {
-            REQUIRE((int) result[i] == (int) expected_values[i]);
+            BigInt* modulus = all_ones(n);
+            BigInt* num1 = all_ones(n - 1);
+            BigInt* num2 = str_BigInt("0xfedcba9876543210fedcba98");
+            BigIntMontCtx* ctx = new_mont_ctx(modulus);
+
+            BigInt* reduced = mod(num2, modulus);
+            BigInt* product = multiply(num1, reduced);
+            BigInt* square = multiply(num1, num1);
+            BigInt* expected_product = mod(product, modulus);
+            BigInt* expected_square = mod(square, modulus);
+
+            std::vector<bucket_t> a = to_buckets(num1, n);
+            std::vector<bucket_t> b = to_buckets(reduced, n);
+            std::vector<bucket_t> result(n);
+
+            to_mont(ctx, a.data(), a.data());
+            to_mont(ctx, b.data(), b.data());
+
+            mont_mul(ctx, result.data(), a.data(), b.data());
+            from_mont(ctx, result.data(), result.data());
+            REQUIRE(result == to_buckets(expected_product, n));
+
+            mont_sqr(ctx, result.data(), a.data());
+            from_mont(ctx, result.data(), result.data());
+            REQUIRE(result == to_buckets(expected_square, n));
+
+            free_mont_ctx(ctx);
+            free_BigInt(modulus);
+            free_BigInt(num1);
+            free_BigInt(num2);
+            free_BigInt(reduced);
+            free_BigInt(product);
+            free_BigInt(square);
+            free_BigInt(expected_product);
+            free_BigInt(expected_square);
         }
-        free_BigInt(num1);
-        free_BigInt(num2);
-        free_BigInt(num3);
     }
-    SECTION("Fib sequence sample 2")
+    SECTION("Products above the NTT threshold do not allocate")
     {
-        bucket_t expected_values[] = { 0xf1, 0x6f};
+        int n = NTT_THRESHOLD;
+        BigInt* modulus = all_ones(n);
+        BigInt* num = all_ones(n - 1);
+        BigInt* square = multiply(num, num);
+        BigInt* expected = mod(square, modulus);
+        BigIntMontCtx* ctx = new_mont_ctx(modulus);
 
-        BigInt* num1 = str_BigInt("0xb520");
-        BigInt* num2 = str_BigInt("0x12511");
-        BigInt* num3 = subtract(num1, num2);
+        std::vector<bucket_t> a = to_buckets(num, n);
+        std::vector<bucket_t> result(n);
+        to_mont(ctx, a.data(), a.data());
 
-        bucket_t* result = m_bigint.get_buckets(num3);
+        BigInt_set_allocator(counting_malloc, counting_realloc, counting_free);
+        total_allocations = 0;
+        mont_mul(ctx, result.data(), a.data(), a.data());
+        mont_sqr(ctx, result.data(), a.data());
+        BigInt_set_allocator(NULL, NULL, NULL);
+        REQUIRE(total_allocations == 0);
 
-        REQUIRE(sign(num3) < 0);
-        for (int i = 0; i < 2; ++i)
-        {
-            REQUIRE((int) result[i] == (int) expected_values[i]);
-        }
-        free_BigInt(num1);
-        free_BigInt(num2);
-        free_BigInt(num3);
+        from_mont(ctx, result.data(), result.data());
+        REQUIRE(result == to_buckets(expected, n));
+
+        free_mont_ctx(ctx);
+        free_BigInt(modulus);
+        free_BigInt(num);
+        free_BigInt(square);
+        free_BigInt(expected);
+    }
+    SECTION("Products with worker threads do not allocate")
+    {
+        int n = 4 * PARALLEL_THRESHOLD;
+        BigInt* modulus = all_ones(n);
+        BigInt* num = all_ones(n - 1);
+        BigInt* square = multiply(num, num);
+        BigInt* expected = mod(square, modulus);
+        BigIntMontCtx* ctx = new_mont_ctx(modulus);
+
+        std::vector<bucket_t> a = to_buckets(num, n);
+        std::vector<bucket_t> result(n);
+        to_mont(ctx, a.data(), a.data());
+
+        REQUIRE(BigInt_set_threads(4) == 0);
+        BigInt_set_allocator(counting_malloc, counting_realloc, counting_free);
+        total_allocations = 0;
+        mont_mul(ctx, result.data(), a.data(), a.data());
+        mont_sqr(ctx, result.data(), a.data());
+        BigInt_set_allocator(NULL, NULL, NULL);
+        REQUIRE(BigInt_set_threads(1) == 0);
+        REQUIRE(total_allocations == 0);
+
+        from_mont(ctx, result.data(), result.data());
+        REQUIRE(result == to_buckets(expected, n));
+
+        free_mont_ctx(ctx);
+        free_BigInt(modulus);
+        free_BigInt(num);
+        free_BigInt(square);
+        free_BigInt(expected);
     }
-#endif
 }
-TEST_CASE("Subtracting BigInt from another BigInt", "[subtract_from]")
+
+TEST_CASE("Barrett modular reduction", "[barrett]")
 {
-    SECTION("add with b1 OR b2 as NULL returns NULL")
+    SECTION("new_barrett_ctx with a NULL or zero modulus returns NULL")
     {
-        BigInt* placeholder = empty_BigInt();
-        REQUIRE(add(placeholder, NULL) == NULL);
-        REQUIRE(add(NULL, placeholder) == NULL);
-        free_BigInt(placeholder);
+        BigInt* zero = empty_BigInt();
+        BigInt* num = val_BigInt(17);
+
+        REQUIRE(new_barrett_ctx(NULL) == NULL);
+        REQUIRE(new_barrett_ctx(zero) == NULL);
+        REQUIRE(barrett_mod(NULL, num) == NULL);
+        REQUIRE(barrett_mod_into(NULL, num) == NULL);
+
+        free_BigInt(zero);
+        free_BigInt(num);
     }
-    SECTION("Trivial subtraction")
+    SECTION("Reducing by an even modulus matches mod")
     {
-        BigInt* num1 = val_BigInt(1);
-        BigInt* num2 = str_BigInt("1");
+        BigInt* modulus = str_BigInt("0x1000000000000000000000000000000000000000000000000000000000000002e");
+        BigIntBarrettCtx* ctx = new_barrett_ctx(modulus);
 
-        subtract_from(num1, num2);
-        REQUIRE(compare_uint(num2, 0) == 0);
-        free_BigInt(num1);
-        free_BigInt(num2);
+        const char* operands[] = { "0x0", "0x2d", "-0x123456789abcdef", 
+            "0x1000000000000000000000000000000000000000000000000000000000000002e",
+            "0x123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef",
+            "-0xfedcba9876543210fedcba9876543210fedcba9876543210fedcba9876543210fedcba9876543210fedcba9876543210fedcba9876543210fedcba9876543210fedcba9876543210" };
+        for (const char* operand : operands)
+        {
+            BigInt* num = str_BigInt(operand);
+            BigInt* expected = mod(num, modulus);
+            BigInt* result = barrett_mod(ctx, num);
+
+            REQUIRE(compare_bigint(result, expected) == 0);
+            REQUIRE(sign(result) == sign(expected));
+
+            REQUIRE(barrett_mod_into(ctx, num) == num);
+            REQUIRE(compare_bigint(num, expected) == 0);
+            REQUIRE(sign(num) == sign(expected));
+
+            free_BigInt(num);
+            free_BigInt(expected);
+            free_BigInt(result);
+        }
+        free_barrett_ctx(ctx);
+        free_BigInt(modulus);
     }
-    SECTION("Subtracting a negative results in addition")
+    SECTION("Reducing values many times longer than the modulus")
     {
-        BigInt* num1 = val_BigInt(0xf0);
-        BigInt* num2 = str_BigInt("-0x0f");
+        int sizes[][2] = { { 1, 40 }, { 7, 100 }, { KARATSUBA_THRESHOLD + 1, 
+                                                    5 * KARATSUBA_THRESHOLD } };
+        for (auto& size : sizes)
+        {
+            BigInt* modulus = all_ones(size[0]);
+            BigInt* num = all_ones(size[1]);
+            BigIntBarrettCtx* ctx = new_barrett_ctx(modulus);
+
+            BigInt* expected = mod(num, modulus);
+            BigInt* result = barrett_mod(ctx, num);
+            REQUIRE(compare_bigint(result, expected) == 0);
+
+            free_barrett_ctx(ctx);
+            free_BigInt(modulus);
+            free_BigInt(num);
+            free_BigInt(expected);
+            free_BigInt(result);
+        }
+    }
+}
 
-        subtract_from(num2, num1);
-        REQUIRE(compare_uint(num1, 0xff) == 0);
+TEST_CASE("Modular exponentiation", "[powmod]")
+{
+    SECTION("powmod with invalid arguments returns NULL")
+    {
+        BigInt* num = val_BigInt(4);
+        BigInt* zero = empty_BigInt();
+        BigInt* negative = str_BigInt("-0x3");
 
-        free_BigInt(num1);
-        free_BigInt(num2);
+        REQUIRE(powmod(NULL, num, num, 0) == NULL);
+        REQUIRE(powmod(num, NULL, num, 0) == NULL);
+        REQUIRE(powmod(num, num, NULL, 0) == NULL);
+        REQUIRE(powmod(num, num, zero, 0) == NULL);
+        REQUIRE(powmod(num, negative, negative, 0) == NULL);
+        REQUIRE(powmod(num, num, num, POWMOD_CONSTANT_TIME) == NULL);
+
+        free_BigInt(num);
+        free_BigInt(zero);
+        free_BigInt(negative);
+    }
+    SECTION("Both windowing methods agree")
+    {
+        const char* cases[][4] = {
+            { "0x4", "0xd", "0x1f1", "0x1bd" },
+            { "-0x2", "0x3", "0x7", "0x6" },
+            { "0x123", "0x0", "0x7", "0x1" },
+            { "0x123", "0x5", "0x1", "0x0" },
+            { "0xfedcba9876543210fedcba98", "0x10001", 
+              "0xc3a5c85c97cb3127b5fd2a8d2f8b2a6d", 
+              "0x60a3bc720cb64fde98090bb0d7627b26" } };
+        for (auto& c : cases)
+        {
+            BigInt* base = str_BigInt(c[0]);
+            BigInt* exp = str_BigInt(c[1]);
+            BigInt* modulus = str_BigInt(c[2]);
+            BigInt* expected = str_BigInt(c[3]);
+
+            BigInt* sliding = powmod(base, exp, modulus, 0);
+            BigInt* fixed = powmod(base, exp, modulus, POWMOD_CONSTANT_TIME);
+
+            REQUIRE(compare_bigint(sliding, expected) == 0);
+            REQUIRE(compare_bigint(fixed, expected) == 0);
+            REQUIRE(sign(sliding) > 0);
+
+            free_BigInt(base);
+            free_BigInt(exp);
+            free_BigInt(modulus);
+            free_BigInt(expected);
+            free_BigInt(sliding);
+            free_BigInt(fixed);
+        }
     }
-    SECTION("Subtracting a larger negative flips the sign")
+    SECTION("Both windowing methods agree above the multiplication thresholds")
     {
-        BigInt* num1 = val_BigInt(0xff);
-        BigInt* num2 = str_BigInt("0x0f");
+        int sizes[] = { KARATSUBA_THRESHOLD, TOOM3_THRESHOLD + 1 };
+        for (int n : sizes)
+        {
+            BigInt* modulus = all_ones(n);
+            BigInt* base = all_ones(n - 1);
+            BigInt* exp = val_BigInt(0x35);
+
+            BigInt* power = pow_BigInt(base, 0x35);
+            BigInt* expected = mod(power, modulus);
+            BigInt* sliding = powmod(base, exp, modulus, 0);
+            BigInt* fixed = powmod(base, exp, modulus, POWMOD_CONSTANT_TIME);
+
+            REQUIRE(compare_bigint(sliding, expected) == 0);
+            REQUIRE(compare_bigint(fixed, expected) == 0);
+
+            free_BigInt(modulus);
+            free_BigInt(base);
+            free_BigInt(exp);
+            free_BigInt(power);
+            free_BigInt(expected);
+            free_BigInt(sliding);
+            free_BigInt(fixed);
+        }
+    }
+    SECTION("Even moduli use Barrett reduction")
+    {
+        BigInt* base = str_BigInt("0xfedcba9876543210fedcba98");
+        BigInt* exp = val_BigInt(0x11);
+        BigInt* modulus = str_BigInt("0xc3a5c85c97cb3127b5fd2a8d2f8b2a6e");
+        BigInt* result = powmod(base, exp, modulus, 0);
 
-        subtract_from(num1, num2);
-        REQUIRE(compare_uint(num2, 240) == 0);
-        REQUIRE(sign(num2) < 0);
+        BigInt* expected = val_BigInt(1);
+        for (int i = 0; i < 0x11; ++i)
+        {
+            BigInt* product = multiply(expected, base);
+            free_BigInt(expected);
+            expected = mod(product, modulus);
+            free_BigInt(product);
+        }
+        REQUIRE(compare_bigint(result, expected) == 0);
 
-        free_BigInt(num1);
-        free_BigInt(num2);
+        free_BigInt(base);
+        free_BigInt(exp);
+        free_BigInt(modulus);
+        free_BigInt(result);
+        free_BigInt(expected);
     }
-    SECTION("-BUCKET_MAX - BUCKET_MAX returns 2BUCKET_MAX")
+    SECTION("Fermat's little theorem holds for a Mersenne prime")
     {
-#if defined( BIGINT__x64 )
-        const char* bucket_max = "0xffffffffffffffff";
-        const char* neg_bucket_max = "-0xffffffffffffffff";
-        bucket_t expected_values[] = { 0xfffffffffffffffe, 0x1 };
-#elif defined( BIGINT__x86 )
-        const char* bucket_max = "0xffffffff";
-        const char* neg_bucket_max = "-0xffffffff";
-        bucket_t expected_values[] = { 0xfffffffe, 0x1 };
-#else // defined (BIGINT__8bit)
-        const char* bucket_max = "0xff";
-        const char* neg_bucket_max = "-0xff";
-        bucket_t expected_values[] = { 0xfe, 0x1 };
-#endif
-        BigInt* num1 = str_BigInt(neg_bucket_max);
-        BigInt* num2 = str_BigInt(bucket_max);
-        
-        subtract_from(num2, num1);
+        // 2^127 - 1 is prime, a^(p - 1) = 1 mod p
+        BigInt* prime = str_BigInt("0x7fffffffffffffffffffffffffffffff");
+        BigInt* exp = str_BigInt("0x7ffffffffffffffffffffffffffffffe");
+        BigInt* base = str_BigInt("0x123456789abcdef");
 
-        bucket_t* result = m_bigint.get_buckets(num1);
+        BigInt* sliding = powmod(base, exp, prime, 0);
+        BigInt* fixed = powmod(base, exp, prime, POWMOD_CONSTANT_TIME);
 
-        REQUIRE(sign(num1) < 0);
-        for (int i = 0; i < buckets(num1); ++i)
-        {
-            REQUIRE(result[i] == (uint64_t) expected_values[i]);
-        }
-        free_BigInt(num1);
-        free_BigInt(num2);
+        REQUIRE(compare_uint(sliding, 1) == 0);
+        REQUIRE(compare_bigint(sliding, fixed) == 0);
+
+        free_BigInt(prime);
+        free_BigInt(exp);
+        free_BigInt(base);
+        free_BigInt(sliding);
+        free_BigInt(fixed);
     }
 }
 